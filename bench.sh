@@ -0,0 +1,4 @@
+# usage: ./bench.sh [instructions], after ./build.sh
+cd build
+for d in switch table threaded; do ./ps1 --dispatch $d --bench ${1:-100000000}; done
+for e in --cached --jit "--jit --fastmem"; do ./ps1 $e --bench ${1:-100000000}; done
@@ -1 +1,2 @@
-gcc src/main.c -Iinclude -o build/ps1 -lglfw
+gcc src/main.c -Iinclude -o build/ps1 -lglfw -lpthread
+gcc src/trace/tracecmp.c -o build/tracecmp
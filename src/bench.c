@@ -0,0 +1,285 @@
+#include "bench.h"
+
+#include <time.h>
+
+#include "cpu.h"
+
+double bench_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// name of the engine cpu_run_for picks for the current mode
+const char* bench_engine(Cpu* cpu) {
+	switch (cpu->mode) {
+	case CPU_MODE_CACHED:
+		return "cached";
+	case CPU_MODE_JIT:
+		return "jit";
+	case CPU_MODE_PROFILE:
+		return "profile";
+	case CPU_MODE_TRACE:
+		return "trace";
+	case CPU_MODE_DEBUG:
+		return "debug";
+	default:
+		return DISPATCH_NAMES[cpu->dispatch];
+	}
+}
+
+// instructions run so far by any engine
+uint64_t bench_executed(Cpu* cpu) {
+	return cpu->fetch_hits + cpu->fetch_misses + cpu->block_ops;
+}
+
+// runs count instructions of the BIOS boot path with the selected engine and
+// exits
+void bench_run(Cpu* cpu, uint64_t count) {
+	Scheduler* s = cpu->intr->scheduler;
+	double start = bench_now();
+
+#ifdef __x86_64__
+	if (cpu->jit != NULL) {
+		// code from a block file doesn't count, compile it again
+		cpu->jit->count_ops = 1;
+		jit_flush(cpu->jit, cpu->cache);
+	}
+#endif
+
+	// every instruction costs at least a cycle, so the block engines are the
+	// only ones that can go past count, by the rest of a block
+	while (bench_executed(cpu) < count) {
+		cpu_run_for(cpu, count - bench_executed(cpu));
+		scheduler_run(s, cpu->cycles);
+	}
+
+	double elapsed = bench_now() - start;
+
+	uint64_t fetches = cpu->fetch_hits + cpu->fetch_misses;
+	uint64_t executed = bench_executed(cpu);
+
+	printf("%s: %llu instructions in %.3f s: %.2f ns/instruction, %.2f MIPS\n",
+	       bench_engine(cpu), (unsigned long long)executed, elapsed,
+	       elapsed * 1e9 / executed, executed / elapsed / 1e6);
+
+	printf("fetch: %llu hits, %llu misses, %.4f%% hit rate\n",
+	       (unsigned long long)cpu->fetch_hits, (unsigned long long)cpu->fetch_misses,
+	       fetches > 0 ? 100.0 * cpu->fetch_hits / fetches : 0.0);
+
+	printf("idle: %llu of %llu cycles skipped\n",
+	       (unsigned long long)cpu->idle.skipped, (unsigned long long)cpu->cycles);
+	exit(0);
+}
+
+typedef struct {
+	const char* name;
+	uint32_t cmd;
+} GteBenchCommand;
+
+// sf=1 unless the name says otherwise, lm=1 on the lighting commands and SQR
+const GteBenchCommand GTE_BENCH_COMMANDS[] = {
+	{ "RTPS", 0x0180001 },
+	{ "RTPT", 0x0280030 },
+	{ "NCLIP", 0x1400006 },
+	{ "OP", 0x178000c },
+	{ "DPCS", 0x0780010 },
+	{ "INTPL", 0x0980011 },
+	{ "MVMVA", 0x0480012 },
+	{ "MVMVA.fc", 0x04ac012 },
+	{ "MVMVA.mx3", 0x04fe012 },
+	{ "NCDS", 0x0e80413 },
+	{ "CDP", 0x1280414 },
+	{ "NCDT", 0x0f80416 },
+	{ "NCCS", 0x108041b },
+	{ "CC", 0x138041c },
+	{ "NCS", 0x0c8041e },
+	{ "NCT", 0x0d80420 },
+	{ "SQR", 0x0a80428 },
+	{ "SQR.sf0", 0x0a00428 },
+	{ "DCPL", 0x0680029 },
+	{ "DPCT", 0x0f8002a },
+	{ "AVSZ3", 0x158002d },
+	{ "AVSZ4", 0x168002e },
+	{ "GPF", 0x198003d },
+	{ "GPL", 0x1a8003e },
+	{ "NCCT", 0x118043f },
+};
+
+// register writes setting up a test vector, control registers are 32 + r
+const uint32_t GTE_BENCH_TYPICAL[][2] = {
+	{ 32, 0x00001000 }, { 33, 0x00000000 }, { 34, 0x00001000 }, { 35, 0x00000000 }, { 36, 0x1000 },
+	{ 37, 0 }, { 38, 0 }, { 39, 0x400 },
+	{ 40, 0x0b500b50 }, { 41, 0xf4b00000 }, { 42, 0x08000800 }, { 43, 0x0b50f800 }, { 44, 0x0800 },
+	{ 45, 0x40 }, { 46, 0x40 }, { 47, 0x40 },
+	{ 48, 0x10000000 }, { 49, 0x00000800 }, { 50, 0x0c000400 }, { 51, 0x04000000 }, { 52, 0x1000 },
+	{ 53, 0x800 }, { 54, 0x400 }, { 55, 0x200 },
+	{ 56, 160 << 16 }, { 57, 120 << 16 }, { 58, 200 }, { 59, 0xffffff00 }, { 60, 0x01400000 },
+	{ 61, 0x155 }, { 62, 0x100 },
+	{ 0, 0x0040ffc0 }, { 1, 0x0080 }, { 2, 0xffc00040 }, { 3, 0x0100 }, { 4, 0x00400040 }, { 5, 0xff80 },
+	{ 6, 0x30806040 }, { 8, 0x0800 }, { 9, 0x0400 }, { 10, 0xfe00 }, { 11, 0x0c00 },
+	{ 12, 0x00100020 }, { 13, 0x00400050 }, { 14, 0x00080060 },
+	{ 16, 0x0400 }, { 17, 0x0500 }, { 18, 0x0600 }, { 19, 0x0700 },
+	{ 20, 0x00102030 }, { 21, 0x00405060 }, { 22, 0x00708090 },
+	{ 24, 0x00012345 }, { 25, 0x00001000 }, { 26, 0xfffff000 }, { 27, 0x00000800 },
+};
+
+const uint32_t GTE_BENCH_SATURATING[][2] = {
+	{ 32, 0x7fff7fff }, { 33, 0x80007fff }, { 34, 0x7fff8000 }, { 35, 0x7fff7fff }, { 36, 0x7fff },
+	{ 37, 0x7fffffff }, { 38, 0x80000000 }, { 39, 0x7fffffff },
+	{ 40, 0x7fff8000 }, { 41, 0x7fff7fff }, { 42, 0x80007fff }, { 43, 0x7fff8000 }, { 44, 0x7fff },
+	{ 45, 0x7fffffff }, { 46, 0x80000000 }, { 47, 0x12345678 },
+	{ 48, 0x7fff7fff }, { 49, 0x7fff8000 }, { 50, 0x7fff7fff }, { 51, 0x80007fff }, { 52, 0x8000 },
+	{ 53, 0x80000000 }, { 54, 0x7fffffff }, { 55, 0xf0000000 },
+	{ 56, 0x7fffffff }, { 57, 0x80000000 }, { 58, 0xffff }, { 59, 0x7fff }, { 60, 0x7fffffff },
+	{ 61, 0x7fff }, { 62, 0x8000 },
+	{ 0, 0x7fff8000 }, { 1, 0x7fff }, { 2, 0x80007fff }, { 3, 0x8000 }, { 4, 0x7fff7fff }, { 5, 0x0001 },
+	{ 6, 0xffffffff }, { 8, 0x7fff }, { 9, 0x8000 }, { 10, 0x7fff }, { 11, 0x8000 },
+	{ 12, 0x7fff8000 }, { 13, 0x80007fff }, { 14, 0x7fff7fff },
+	{ 16, 0xffff }, { 17, 0xffff }, { 18, 0xffff }, { 19, 0x0000 },
+	{ 20, 0xffffffff }, { 21, 0x00000000 }, { 22, 0x80808080 },
+	{ 24, 0x7fffffff }, { 25, 0x80000000 }, { 26, 0x7fffffff }, { 27, 0x80000000 },
+};
+
+// FLAG and register hash after one run of each command from the vector, in
+// GTE_BENCH_COMMANDS order. Generated with a separate model of the GTE
+// written from the psx-spx description, not from gte.c.
+const uint32_t GTE_BENCH_TYPICAL_EXPECTED[][2] = {
+	{ 0x00001000, 0xe498ba2e }, // RTPS
+	{ 0x00001000, 0xec566e7c }, // RTPT
+	{ 0x00000000, 0x630f055e }, // NCLIP
+	{ 0x00000000, 0x9378d3b7 }, // OP
+	{ 0x00000000, 0x94836d47 }, // DPCS
+	{ 0x00000000, 0x898a0347 }, // INTPL
+	{ 0x00000000, 0xee651f57 }, // MVMVA
+	{ 0x00000000, 0xc74cfe57 }, // MVMVA.fc
+	{ 0x00000000, 0xb7f0504f }, // MVMVA.mx3
+	{ 0x00000000, 0x45d05201 }, // NCDS
+	{ 0x00000000, 0x69061167 }, // CDP
+	{ 0x80c00000, 0xd1a5938c }, // NCDT
+	{ 0x00000000, 0xbf14be53 }, // NCCS
+	{ 0x00000000, 0x84a0c212 }, // CC
+	{ 0x00000000, 0x00286db2 }, // NCS
+	{ 0x80c00000, 0xb3ed0d16 }, // NCT
+	{ 0x00000000, 0xdbfb08c7 }, // SQR
+	{ 0x81c00000, 0xfb1b0f00 }, // SQR.sf0
+	{ 0x00000000, 0x81e0b9f7 }, // DCPL
+	{ 0x00000000, 0xb13b55ff }, // DPCT
+	{ 0x00000000, 0x349bd671 }, // AVSZ3
+	{ 0x00000000, 0x68a1f3be }, // AVSZ4
+	{ 0x00100000, 0xf2746b47 }, // GPF
+	{ 0x00300000, 0xad0269d0 }, // GPL
+	{ 0x80c00000, 0xe883d200 }, // NCCT
+};
+
+const uint32_t GTE_BENCH_SATURATING_EXPECTED[][2] = {
+	{ 0xd1c7f000, 0xcee1374e }, // RTPS
+	{ 0xffc7f000, 0xef340ece }, // RTPT
+	{ 0x80010000, 0x38323ba4 }, // NCLIP
+	{ 0x00000000, 0x0eab8902 }, // OP
+	{ 0x89f80000, 0x2133bbe6 }, // DPCS
+	{ 0x81f80000, 0x9e11f639 }, // INTPL
+	{ 0xd1c00000, 0xec1c9d02 }, // MVMVA
+	{ 0xa9c00000, 0x33ff50be }, // MVMVA.fc
+	{ 0x81c00000, 0x3d4133d2 }, // MVMVA.mx3
+	{ 0xc9f80000, 0x9bf7fef2 }, // NCDS
+	{ 0xc5f80000, 0x392fe20a }, // CDP
+	{ 0xc9f80000, 0x1054b1f2 }, // NCDT
+	{ 0xc9e80000, 0x5692ae7e }, // NCCS
+	{ 0xc5d80000, 0x780a35d9 }, // CC
+	{ 0xc9f80000, 0x50fde695 }, // NCS
+	{ 0xc9f80000, 0x16896aa2 }, // NCT
+	{ 0x81c00000, 0x98e3bd6d }, // SQR
+	{ 0x81c00000, 0x927a78ec }, // SQR.sf0
+	{ 0x81f80000, 0x6f1706b9 }, // DCPL
+	{ 0x89f80000, 0xc9907929 }, // DPCT
+	{ 0x80050000, 0xbe6c4bf4 }, // AVSZ3
+	{ 0x80048000, 0x08f020e5 }, // AVSZ4
+	{ 0x81f80000, 0x43b1f856 }, // GPF
+	{ 0xabf80000, 0xef21eca5 }, // GPL
+	{ 0xc9e80000, 0xeec29f2e }, // NCCT
+};
+
+typedef struct {
+	const char* name;
+	const uint32_t (*regs)[2];
+	uint32_t count;
+	const uint32_t (*expected)[2];
+} GteBenchVector;
+
+#define GTE_BENCH_VECTOR(name, regs, expected) { name, regs, sizeof(regs) / sizeof(regs[0]), expected }
+
+const GteBenchVector GTE_BENCH_VECTORS[] = {
+	GTE_BENCH_VECTOR("typical", GTE_BENCH_TYPICAL, GTE_BENCH_TYPICAL_EXPECTED),
+	GTE_BENCH_VECTOR("saturating", GTE_BENCH_SATURATING, GTE_BENCH_SATURATING_EXPECTED),
+};
+
+uint32_t bench_gte_hash(Gte* gte) {
+	uint32_t h = 0x811c9dc5;
+
+	for (uint32_t r = 0; r < 32; ++r) {
+		h = (h ^ gte_read_data(gte, r)) * 0x01000193;
+		h = (h ^ gte_read_control(gte, r)) * 0x01000193;
+	}
+
+	return h;
+}
+
+// runs every command count times on each test vector and exits. FLAG and a
+// hash of all registers after a single run from the vector are checked
+// against the expected values, any mismatch makes the exit status 1.
+void bench_gte(uint64_t count) {
+	Gte base;
+	Gte gte;
+	int failed = 0;
+
+	for (int v = 0; v < sizeof(GTE_BENCH_VECTORS) / sizeof(GTE_BENCH_VECTORS[0]); ++v) {
+		const GteBenchVector* vector = &GTE_BENCH_VECTORS[v];
+
+		gte_reset(&base);
+
+		for (int i = 0; i < vector->count; ++i) {
+			uint32_t r = vector->regs[i][0];
+
+			if (r < 32) {
+				gte_write_data(&base, r, vector->regs[i][1]);
+			} else {
+				gte_write_control(&base, r - 32, vector->regs[i][1]);
+			}
+		}
+
+		printf("%s:\n", vector->name);
+
+		for (int c = 0; c < sizeof(GTE_BENCH_COMMANDS) / sizeof(GTE_BENCH_COMMANDS[0]); ++c) {
+			const GteBenchCommand* command = &GTE_BENCH_COMMANDS[c];
+
+			gte = base;
+			gte_command(&gte, command->cmd);
+
+			uint32_t flag = gte.flag;
+			uint32_t hash = bench_gte_hash(&gte);
+
+			// the state keeps changing between runs, like in a game loop
+			double start = bench_now();
+
+			for (uint64_t i = 0; i < count; ++i) {
+				gte_command(&gte, command->cmd);
+			}
+
+			double elapsed = bench_now() - start;
+
+			printf("  %-10s flag %08x regs %08x %8.2f ns", command->name, flag, hash,
+			       elapsed * 1e9 / count);
+
+			if (flag != vector->expected[c][0] || hash != vector->expected[c][1]) {
+				printf("  expected flag %08x regs %08x", vector->expected[c][0], vector->expected[c][1]);
+				failed = 1;
+			}
+
+			printf("\n");
+		}
+	}
+
+	exit(failed);
+}
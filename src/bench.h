@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+typedef struct Cpu Cpu;
+
+double bench_now();
+void bench_run(Cpu* cpu, uint64_t count);
+void bench_gte(uint64_t count);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "platform.h"
 
@@ -23,12 +24,15 @@ Bios* initialize_bios(const char* path) {
 }
 
 uint32_t bios_load32(Bios* bios, uint32_t offset) {
-    uint32_t b0 = bios->data[offset + 0];
-    uint32_t b1 = bios->data[offset + 1];
-    uint32_t b2 = bios->data[offset + 2];
-    uint32_t b3 = bios->data[offset + 3];
-    
-    return b0 | (b1 << 8) | (b2 << 16) | (b3 << 24);
+    uint32_t v;
+    memcpy(&v, bios->data + offset, 4);
+    return v;
+}
+
+uint16_t bios_load16(Bios* bios, uint32_t offset) {
+    uint16_t v;
+    memcpy(&v, bios->data + offset, 2);
+    return v;
 }
 
 uint8_t bios_load8(Bios* bios, uint32_t offset) {
@@ -0,0 +1,278 @@
+#include "block.h"
+
+#include "cpu.h"
+#include "interconnect.h"
+
+BlockCache* initialize_block_cache() {
+	BlockCache* cache = malloc(sizeof(BlockCache));
+
+	cache->ram_blocks = calloc(RAM_SIZE / 4, sizeof(Block*));
+	cache->bios_blocks = calloc(BIOS_SIZE / 4, sizeof(Block*));
+
+	for (int i = 0; i < BLOCK_PAGE_COUNT; ++i) {
+		cache->page_gen[i] = 0;
+	}
+
+	for (int i = 0; i < BLOCK_PAGE_COUNT / 64; ++i) {
+		cache->code[i] = 0;
+		cache->stale[i] = 0;
+	}
+
+	cache->dirty = 0;
+	cache->collect = 0;
+
+	return cache;
+}
+
+// 0: keep going, 1: block ends with this op, 2: block ends after the delay slot
+char block_ends_after(OpHandler handler, Instruction instr) {
+	if (handler == op_j || handler == op_jal || handler == op_jr || handler == op_jalr
+	    || handler == op_beq || handler == op_bne || handler == op_blez || handler == op_bgtz
+	    || handler == op_bltz || handler == op_bgez || handler == op_bltzal || handler == op_bgezal) {
+		return 2;
+	}
+
+	// anything that raises an exception or changes cop0 state. The gte ops
+	// only fault like loads and stores do, which the run loops already catch
+	if (handler == op_syscall || handler == op_break || handler == op_illegal
+	    || handler == op_mtc0 || handler == op_rfe || handler == op_cop0 || handler == op_bcondz
+	    || handler == op_cop1 || handler == op_cop3
+	    || handler == op_lwc0 || handler == op_lwc1 || handler == op_lwc3
+	    || handler == op_swc0 || handler == op_swc1 || handler == op_swc3) {
+		return 1;
+	}
+
+	return 0;
+}
+
+// decodes op index of the block starting at addr. Padding included, blocks
+// are written out byte for byte by blockfile_save and compared on load.
+void block_decode(Cpu* cpu, Decoded* op, Instruction word, uint32_t addr, uint32_t index) {
+	memset(op, 0, sizeof(Decoded));
+	cpu_decode(cpu, op, word, addr + index * 4);
+
+	// the rest of a line is valid once one op of it was fetched
+	if (index > 0 && ((addr + index * 4) & ((1 << ICACHE_LINE_SHIFT) - 1)) != 0) {
+		op->icache = 0;
+	}
+}
+
+Block* block_compile(BlockCache* cache, Cpu* cpu, uint32_t addr) {
+	uint32_t phys = mask_region(addr);
+	uint32_t end;
+
+	if (range_contains(BIOS_RANGE, phys) == 1) {
+		end = BIOS_RANGE[0] + BIOS_SIZE;
+	} else {
+		end = RAM_SIZE;
+	}
+
+	BlockOp ops[BLOCK_MAX_OPS];
+	uint32_t len = 0;
+	char delay_slot = 0;
+
+	while (len < BLOCK_MAX_OPS && phys + len * 4 < end) {
+		Instruction instr = intr_load32(cpu->intr, addr + len * 4);
+		OpHandler handler = op_handler(instr);
+
+		ops[len].handler = handler;
+		block_decode(cpu, &ops[len].instr, instr, addr, len);
+
+		len += 1;
+
+		if (delay_slot == 1) {
+			break;
+		}
+
+		char e = block_ends_after(handler, instr);
+
+		if (e == 1) {
+			break;
+		}
+
+		if (e == 2) {
+			delay_slot = 1;
+			continue;
+		}
+
+		// don't spill into the next page unless it's a delay slot
+		if (((phys + len * 4) & ((1 << BLOCK_PAGE_SHIFT) - 1)) == 0) {
+			break;
+		}
+	}
+
+	Block* b = malloc(sizeof(Block) + len * sizeof(BlockOp));
+	b->addr = phys;
+	b->vaddr = addr;
+	b->len = len;
+	b->code = NULL;
+	b->code_size = 0;
+
+	for (int i = 0; i < len; ++i) {
+		b->ops[i] = ops[i];
+	}
+
+	if (phys < RAM_SIZE) {
+		b->page[0] = phys >> BLOCK_PAGE_SHIFT;
+		b->page[1] = (phys + (len - 1) * 4) >> BLOCK_PAGE_SHIFT;
+
+		for (int i = 0; i < 2; ++i) {
+			b->gen[i] = cache->page_gen[b->page[i]];
+			cache->code[b->page[i] >> 6] |= 1ull << (b->page[i] & 63);
+		}
+	} else {
+		b->page[0] = b->page[1] = 0;
+		b->gen[0] = b->gen[1] = 0;
+	}
+
+	return b;
+}
+
+char block_stale(BlockCache* cache, Block* b) {
+	return b->gen[0] != cache->page_gen[b->page[0]] || b->gen[1] != cache->page_gen[b->page[1]];
+}
+
+Block* block_cache_lookup(BlockCache* cache, Cpu* cpu) {
+	uint32_t phys = mask_region(cpu->pc);
+	Block** slot;
+
+	if (cache->collect == 1) {
+		block_cache_collect(cache);
+	}
+
+	if (phys < RAM_SIZE) {
+		slot = &cache->ram_blocks[phys >> 2];
+
+		Block* b = *slot;
+
+		if (b != NULL && b->vaddr == cpu->pc && block_stale(cache, b) == 0) {
+			return b;
+		}
+	} else if (range_contains(BIOS_RANGE, phys) == 1 && phys < BIOS_RANGE[0] + BIOS_SIZE) {
+		slot = &cache->bios_blocks[range_offset(BIOS_RANGE, phys) >> 2];
+
+		if (*slot != NULL && (*slot)->vaddr == cpu->pc) {
+			return *slot;
+		}
+	} else {
+		return NULL;
+	}
+
+	// stale blocks are only freed here, never while they might be running
+	free(*slot);
+	*slot = block_compile(cache, cpu, cpu->pc);
+
+	return *slot;
+}
+
+void block_cache_invalidate(BlockCache* cache, uint32_t addr) {
+	uint32_t phys = mask_region(addr);
+
+	// fastmem lets stores through the RAM mirrors in the first 8 MB
+	if (phys >= RAM_SIZE * 4) {
+		return;
+	}
+
+	phys &= RAM_SIZE - 1;
+
+	uint32_t page = phys >> BLOCK_PAGE_SHIFT;
+	uint64_t bit = 1ull << (page & 63);
+
+	if ((cache->code[page >> 6] & bit) != 0) {
+		cache->code[page >> 6] &= ~bit;
+		cache->stale[page >> 6] |= bit;
+		cache->page_gen[page] += 1;
+		cache->dirty = 1;
+	}
+}
+
+// invalidates every page touched by [addr, addr + size)
+void block_cache_invalidate_range(BlockCache* cache, uint32_t addr, uint32_t size) {
+	if (size == 0) {
+		return;
+	}
+
+	uint32_t first = addr >> BLOCK_PAGE_SHIFT;
+	uint32_t last = (addr + size - 1) >> BLOCK_PAGE_SHIFT;
+
+	for (uint32_t page = first; page <= last; ++page) {
+		block_cache_invalidate(cache, page << BLOCK_PAGE_SHIFT);
+	}
+}
+
+// Frees the blocks left behind on stale pages. Blocks stop at a page boundary
+// except for a delay slot, so a block reaching into a stale page from the one
+// before starts in its last BLOCK_MAX_OPS words. Only called from lookup, never
+// while a block might be running.
+void block_cache_collect(BlockCache* cache) {
+	for (uint32_t page = 0; page < BLOCK_PAGE_COUNT; ++page) {
+		if ((cache->stale[page >> 6] & (1ull << (page & 63))) == 0) {
+			continue;
+		}
+
+		uint32_t start = page << BLOCK_PAGE_SHIFT;
+		uint32_t end = start + (1 << BLOCK_PAGE_SHIFT);
+
+		if (page > 0) {
+			start -= BLOCK_MAX_OPS * 4;
+		}
+
+		for (uint32_t addr = start; addr < end; addr += 4) {
+			Block** slot = &cache->ram_blocks[addr >> 2];
+
+			if (*slot != NULL && block_stale(cache, *slot) == 1) {
+				free(*slot);
+				*slot = NULL;
+			}
+		}
+	}
+
+	for (int i = 0; i < BLOCK_PAGE_COUNT / 64; ++i) {
+		cache->stale[i] = 0;
+	}
+
+	cache->collect = 0;
+}
+
+void run_next_block(Cpu* cpu) {
+	BlockCache* cache = cpu->cache;
+
+	if (cpu->pc % 4 != 0 || cpu_fetch_hooked(cpu) == 1) {
+		return run_next_instruction(cpu);
+	}
+
+	Block* b = block_cache_lookup(cache, cpu);
+
+	if (b == NULL) {
+		return run_next_instruction(cpu);
+	}
+
+	for (int i = 0; i < b->len; ++i) {
+		BlockOp* op = &b->ops[i];
+
+		if (op->instr.icache == 1) {
+			cpu_icache_fetch(cpu, &op->instr);
+		}
+
+		cpu->cycles += op->instr.cycles;
+		cpu->block_ops += 1;
+
+		cpu->curr_pc = cpu->pc;
+		cpu->pc = cpu->next_pc;
+		cpu->next_pc += 4;
+
+		cpu->delay_slot = cpu->branch;
+		cpu->branch = 0;
+
+		op->handler(cpu, &op->instr);
+
+		retire_load(cpu);
+
+		// exception taken, or we just overwrote our own code
+		if (cpu->pc != cpu->curr_pc + 4 || cache->dirty == 1) {
+			break;
+		}
+	}
+
+	cache->dirty = 0;
+}
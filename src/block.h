@@ -0,0 +1,67 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdint.h>
+
+#include "platform.h"
+#include "instruction.h"
+#include "ram.h"
+
+// guest code is tracked in 4 kB pages for invalidation
+#define BLOCK_PAGE_SHIFT 12
+#define BLOCK_PAGE_COUNT (RAM_SIZE >> BLOCK_PAGE_SHIFT)
+#define BLOCK_MAX_OPS 64
+
+typedef struct Cpu Cpu;
+
+typedef void (*OpHandler)(Cpu* cpu, Decoded* instr);
+
+typedef struct {
+    OpHandler handler;
+    Decoded instr;
+} BlockOp;
+
+typedef struct Block {
+    uint32_t addr; // physical address of the first instruction
+    uint32_t vaddr; // address it was compiled for, branch targets are absolute
+    uint32_t len;
+
+    // page generations at compile time, first and last page
+    uint32_t page[2];
+    uint32_t gen[2];
+
+    void* code; // host code, filled in by the jit
+    uint32_t code_size;
+
+    BlockOp ops[];
+} Block;
+
+typedef struct BlockCache {
+    Block** ram_blocks; // indexed by RAM word
+    Block** bios_blocks; // indexed by BIOS word
+
+    uint32_t page_gen[BLOCK_PAGE_COUNT];
+
+    // one bit per page: pages blocks were compiled from, and pages whose blocks
+    // went stale since the last collection
+    uint64_t code[BLOCK_PAGE_COUNT / 64];
+    uint64_t stale[BLOCK_PAGE_COUNT / 64];
+
+    // set when a page holding code is written, the running block bails out
+    char dirty;
+    // set when the guest finished an icache flush, stale blocks are freed on
+    // the next lookup
+    char collect;
+} BlockCache;
+
+BlockCache* initialize_block_cache();
+Block* block_cache_lookup(BlockCache* cache, Cpu* cpu);
+Block* block_compile(BlockCache* cache, Cpu* cpu, uint32_t addr);
+void block_decode(Cpu* cpu, Decoded* op, Instruction word, uint32_t addr, uint32_t index);
+void block_cache_invalidate(BlockCache* cache, uint32_t addr);
+void block_cache_invalidate_range(BlockCache* cache, uint32_t addr, uint32_t size);
+void block_cache_collect(BlockCache* cache);
+char block_ends_after(OpHandler handler, Instruction instr);
+void run_next_block(Cpu* cpu);
+
+#endif
@@ -0,0 +1,237 @@
+#include "blockfile.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+#ifdef __x86_64__
+#include "jit/jit.h"
+#endif
+
+uint64_t blockfile_hash(uint8_t* data, uint32_t size) {
+	uint64_t h = 0xcbf29ce484222325;
+
+	for (uint32_t i = 0; i < size; ++i) {
+		h = (h ^ data[i]) * 0x100000001b3;
+	}
+
+	return h;
+}
+
+BlockFile* initialize_blockfile(const char* dir, Cpu* cpu) {
+	BlockFile* f = malloc(sizeof(BlockFile));
+
+	f->cpu = cpu;
+	f->loaded = 0;
+	f->loaded_code = 0;
+	f->bios_hash = blockfile_hash(cpu->intr->bios->data, BIOS_SIZE);
+
+	size_t len = strlen(dir) + 32;
+	f->path = malloc(len);
+	snprintf(f->path, len, "%s/%016llx.blocks", dir, (unsigned long long)f->bios_hash);
+
+	return f;
+}
+
+// The header already ties the file to this BIOS and build, so only cheap
+// checks are made: each op is the BIOS word at its address, and nothing in it
+// indexes past the registers or the handlers.
+char blockfile_record_valid(BlockFile* f, BlockFileRecord* r, Decoded* ops) {
+	uint32_t phys = mask_region(r->vaddr);
+
+	if (r->len == 0 || r->len > BLOCK_MAX_OPS || r->vaddr % 4 != 0
+	    || phys - BIOS_RANGE[0] >= BIOS_SIZE || phys - BIOS_RANGE[0] + r->len * 4 > BIOS_SIZE) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < r->len; ++i) {
+		Decoded* op = &ops[i];
+
+		if (op->word != bios_load32(f->cpu->intr->bios, phys - BIOS_RANGE[0] + i * 4)
+		    || op->pc != r->vaddr + i * 4 || op->id >= 128
+		    || op->s >= 32 || op->t >= 32 || op->d >= 32 || op->shift >= 32) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// maps the file and fills the BIOS slots of the cache, a missing or stale
+// file just means everything is compiled as usual
+void blockfile_load(BlockFile* f) {
+	int fd = open(f->path, O_RDONLY);
+
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(BlockFileHeader)) {
+		close(fd);
+		return;
+	}
+
+	uint8_t* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		return;
+	}
+
+	BlockFileHeader* h = (BlockFileHeader*)data;
+
+	if (h->magic != BLOCKFILE_MAGIC || h->version != BLOCKFILE_VERSION
+	    || h->op_size != sizeof(Decoded) || h->bios_hash != f->bios_hash
+	    || strncmp(h->build, BLOCKFILE_BUILD, sizeof(h->build)) != 0) {
+		printf("ignoring stale block file %s\n", f->path);
+		munmap(data, st.st_size);
+		return;
+	}
+
+	size_t at = sizeof(BlockFileHeader);
+
+	for (uint32_t i = 0; i < h->count; ++i) {
+		if (at + sizeof(BlockFileRecord) > st.st_size) {
+			break;
+		}
+
+		BlockFileRecord* r = (BlockFileRecord*)(data + at);
+		Decoded* ops = (Decoded*)(data + at + sizeof(BlockFileRecord));
+		uint8_t* code = (uint8_t*)(ops + r->len);
+		at += sizeof(BlockFileRecord) + (size_t)r->len * sizeof(Decoded) + r->code_size;
+
+		if (at > st.st_size || blockfile_record_valid(f, r, ops) == 0) {
+			printf("ignoring stale block file %s\n", f->path);
+			break;
+		}
+
+		Block** slot = &f->cpu->cache->bios_blocks[range_offset(BIOS_RANGE, mask_region(r->vaddr)) >> 2];
+
+		if (*slot != NULL) {
+			continue;
+		}
+
+		Block* b = malloc(sizeof(Block) + r->len * sizeof(BlockOp));
+		b->addr = mask_region(r->vaddr);
+		b->vaddr = r->vaddr;
+		b->len = r->len;
+		b->code = NULL;
+		b->code_size = 0;
+		b->page[0] = b->page[1] = 0;
+		b->gen[0] = b->gen[1] = 0;
+
+		for (uint32_t j = 0; j < r->len; ++j) {
+			b->ops[j].handler = op_handler(ops[j].word);
+			b->ops[j].instr = ops[j];
+		}
+
+#ifdef __x86_64__
+		if (f->cpu->jit != NULL && f->cpu->jit->fastmem == h->fastmem
+		    && r->code_size > 0 && r->code_size <= r->len * JIT_MAX_OP_SIZE + 64) {
+			jit_load(f->cpu->jit, f->cpu->cache, b, code, r->code_size);
+			f->loaded_code += 1;
+		}
+#endif
+
+		*slot = b;
+		f->loaded += 1;
+	}
+
+	munmap(data, st.st_size);
+}
+
+// bytes of jit code kept for b. Code counting ops for --bench is left out,
+// it doesn't belong to a normal run.
+uint32_t blockfile_code_size(BlockFile* f, Block* b) {
+#ifdef __x86_64__
+	if (b->code != NULL && f->cpu->jit != NULL && f->cpu->jit->count_ops == 0) {
+		return b->code_size;
+	}
+#endif
+
+	return 0;
+}
+
+// writes a temporary file and renames it over the old one, so machines
+// starting at the same time never see half a file
+void blockfile_save(BlockFile* f) {
+	BlockFileHeader h = { BLOCKFILE_MAGIC, BLOCKFILE_VERSION, sizeof(Decoded), 0, f->bios_hash, BLOCKFILE_BUILD, 0 };
+	uint32_t with_code = 0;
+
+#ifdef __x86_64__
+	if (f->cpu->jit != NULL) {
+		h.fastmem = f->cpu->jit->fastmem;
+	}
+#endif
+
+	for (int i = 0; i < BIOS_SIZE / 4; ++i) {
+		Block* b = f->cpu->cache->bios_blocks[i];
+
+		if (b != NULL) {
+			h.count += 1;
+			with_code += blockfile_code_size(f, b) > 0;
+		}
+	}
+
+	if (h.count <= f->loaded && with_code <= f->loaded_code) {
+		return;
+	}
+
+	size_t len = strlen(f->path) + 32;
+	char* tmp = malloc(len);
+	snprintf(tmp, len, "%s.%d.tmp", f->path, (int)getpid());
+
+	FILE* out = fopen(tmp, "wb");
+
+	if (out == NULL) {
+		printf("failed to write block file %s\n", tmp);
+		free(tmp);
+		return;
+	}
+
+	fwrite(&h, sizeof(h), 1, out);
+
+	for (int i = 0; i < BIOS_SIZE / 4; ++i) {
+		Block* b = f->cpu->cache->bios_blocks[i];
+
+		if (b == NULL) {
+			continue;
+		}
+
+		BlockFileRecord r = { b->vaddr, b->len, blockfile_code_size(f, b) };
+		fwrite(&r, sizeof(r), 1, out);
+
+		for (uint32_t j = 0; j < b->len; ++j) {
+			fwrite(&b->ops[j].instr, sizeof(Decoded), 1, out);
+		}
+
+		if (r.code_size > 0) {
+			fwrite(b->code, 1, r.code_size, out);
+		}
+	}
+
+	fclose(out);
+
+	if (rename(tmp, f->path) != 0) {
+		printf("failed to write block file %s\n", f->path);
+		remove(tmp);
+	}
+
+	free(tmp);
+}
+
+BlockFile* blockfile_exit_save = NULL;
+
+void blockfile_exit() {
+	blockfile_save(blockfile_exit_save);
+}
+
+void blockfile_save_at_exit(BlockFile* f) {
+	blockfile_exit_save = f;
+	atexit(blockfile_exit);
+}
@@ -0,0 +1,50 @@
+#ifndef BLOCKFILE_H
+#define BLOCKFILE_H
+
+#include <stdint.h>
+
+#include "block.h"
+
+#define BLOCKFILE_MAGIC 0x4b4c4250 // "PBLK"
+// bump whenever decoding or the cycle costs change, old files are ignored
+#define BLOCKFILE_VERSION 2
+// host code bakes in struct offsets, so it is only reused by the same build
+#define BLOCKFILE_BUILD __DATE__ " " __TIME__
+
+// The BIOS never changes under a running machine, so the blocks compiled from
+// it are written to <dir>/<bios hash>.blocks at exit and read back on the
+// next start, together with their jit code. The code reaches everything
+// through the cpu and the block, so it is copied into the jit as is.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t op_size; // sizeof(Decoded)
+    uint32_t count; // records that follow
+    uint64_t bios_hash;
+    char build[24]; // BLOCKFILE_BUILD
+    char fastmem; // the code goes through the fastmem window
+} BlockFileHeader;
+
+// followed by len Decoded and code_size bytes of jit code
+typedef struct {
+    uint32_t vaddr;
+    uint32_t len;
+    uint32_t code_size; // 0 if the block never ran in the jit
+} BlockFileRecord;
+
+typedef struct {
+    char* path;
+    uint64_t bios_hash;
+    // read at startup, nothing is written unless either grew
+    uint32_t loaded;
+    uint32_t loaded_code;
+
+    Cpu* cpu; // owns the cache and the jit the blocks go into
+} BlockFile;
+
+BlockFile* initialize_blockfile(const char* dir, Cpu* cpu);
+void blockfile_load(BlockFile* f);
+void blockfile_save(BlockFile* f);
+void blockfile_save_at_exit(BlockFile* f);
+
+#endif
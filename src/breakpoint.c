@@ -0,0 +1,126 @@
+#include "breakpoint.h"
+
+#include "cpu.h"
+
+void initialize_breakpoints(Breakpoints* bp) {
+	bp->bpc = 0;
+	bp->bda = 0;
+	bp->dcic = 0;
+	bp->bdam = 0;
+	bp->bpcm = 0;
+	bp->mode = CPU_MODE_INTERPRETER;
+}
+
+char breakpoint_armed(Breakpoints* bp) {
+	return (bp->dcic & DCIC_ENABLE) == DCIC_ENABLE && (bp->dcic & (DCIC_CODE | DCIC_DATA)) != 0;
+}
+
+// swaps to the checking loop when breakpoints get armed and back when they
+// are disarmed
+void breakpoint_write(Cpu* cpu, uint32_t r, uint32_t v) {
+	Breakpoints* bp = &cpu->breakpoints;
+
+	switch (r) {
+	case 3:
+		bp->bpc = v;
+		break;
+	case 5:
+		bp->bda = v;
+		break;
+	case 7:
+		bp->dcic = v;
+		break;
+	case 9:
+		bp->bdam = v;
+		break;
+	case 11:
+		bp->bpcm = v;
+		break;
+	}
+
+	char armed = breakpoint_armed(bp);
+
+	if (armed == 1 && cpu->mode != CPU_MODE_DEBUG) {
+		bp->mode = cpu->mode;
+		cpu->mode = CPU_MODE_DEBUG;
+		cpu_yield(cpu);
+	} else if (armed == 0 && cpu->mode == CPU_MODE_DEBUG) {
+		cpu->mode = bp->mode;
+	}
+}
+
+uint32_t breakpoint_read(Cpu* cpu, uint32_t r) {
+	Breakpoints* bp = &cpu->breakpoints;
+
+	switch (r) {
+	case 3:
+		return bp->bpc;
+	case 5:
+		return bp->bda;
+	case 7:
+		return bp->dcic;
+	case 9:
+		return bp->bdam;
+	default:
+		return bp->bpcm;
+	}
+}
+
+// Checks the instruction at pc before it runs, returns 1 if the debug
+// exception was taken instead. The data address is worked out from the
+// undecoded word, the load delay means regs already hold what it will see.
+char breakpoint_check(Cpu* cpu) {
+	Breakpoints* bp = &cpu->breakpoints;
+	uint32_t hit = 0;
+
+	if ((bp->dcic & DCIC_CODE) != 0 && ((cpu->pc ^ bp->bpc) & bp->bpcm) == 0) {
+		hit |= DCIC_HIT_ANY | DCIC_HIT_CODE;
+	}
+
+	if ((bp->dcic & DCIC_DATA) != 0) {
+		uint32_t word = cpu_peek32(cpu, cpu->pc);
+		uint32_t op = word >> 26;
+		uint32_t addr = cpu->regs[(word >> 21) & 0x1f] + (uint32_t)(int16_t)word;
+
+		// loads, lwc2 / stores, swc2
+		char read = (op >= 0x20 && op <= 0x26) || op == 0x32;
+		char write = (op >= 0x28 && op <= 0x2e) || op == 0x3a;
+
+		if (((addr ^ bp->bda) & bp->bdam) == 0) {
+			if (read == 1 && (bp->dcic & DCIC_READ) != 0) {
+				hit |= DCIC_HIT_ANY | DCIC_HIT_DATA | DCIC_HIT_READ;
+			}
+
+			if (write == 1 && (bp->dcic & DCIC_WRITE) != 0) {
+				hit |= DCIC_HIT_ANY | DCIC_HIT_DATA | DCIC_HIT_WRITE;
+			}
+		}
+	}
+
+	if (hit == 0) {
+		return 0;
+	}
+
+	bp->dcic |= hit;
+
+	cpu->curr_pc = cpu->pc;
+	cpu->delay_slot = cpu->branch;
+	cpu->branch = 0;
+
+	exception_vector(cpu, BREAK, (cpu->sr & (1 << 22)) != 0 ? DEBUG_VECTOR_BEV : DEBUG_VECTOR);
+	retire_load(cpu);
+
+	return 1;
+}
+
+// the interpreter with a check in front of every instruction, returns once
+// the breakpoints are disarmed so cpu_run_for goes back to the normal loop
+void run_breakpoints(Cpu* cpu) {
+	while (cpu->cycles < cpu->deadline && cpu->mode == CPU_MODE_DEBUG) {
+		if (cpu->pc % 4 == 0 && breakpoint_check(cpu) == 1) {
+			continue;
+		}
+
+		run_next_instruction(cpu);
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef BREAKPOINT_H
+#define BREAKPOINT_H
+
+#include <stdint.h>
+
+// DCIC: bits 0-4 are set by hits, which also raise the debug exception.
+// Nothing is checked unless bits 23, 30 and 31 are all set.
+#define DCIC_HIT_ANY (1 << 0)
+#define DCIC_HIT_CODE (1 << 1)
+#define DCIC_HIT_DATA (1 << 2)
+#define DCIC_HIT_READ (1 << 3)
+#define DCIC_HIT_WRITE (1 << 4)
+#define DCIC_CODE (1 << 24)
+#define DCIC_DATA (1 << 25)
+#define DCIC_READ (1 << 26)
+#define DCIC_WRITE (1 << 27)
+#define DCIC_ENABLE ((1 << 23) | (1 << 30) | (1u << 31))
+
+#define DEBUG_VECTOR 0x80000040
+#define DEBUG_VECTOR_BEV 0xbfc00140
+
+typedef struct Cpu Cpu;
+
+// cop0 breakpoint registers. While any breakpoint is armed the cpu runs
+// run_breakpoints instead of its own loop, so the other loops never check.
+typedef struct {
+    uint32_t bpc; // r3
+    uint32_t bda; // r5
+    uint32_t dcic; // r7
+    uint32_t bdam; // r9
+    uint32_t bpcm; // r11
+
+    uint8_t mode; // CpuMode to go back to once disarmed
+} Breakpoints;
+
+void initialize_breakpoints(Breakpoints* bp);
+char breakpoint_armed(Breakpoints* bp);
+void breakpoint_write(Cpu* cpu, uint32_t r, uint32_t v);
+uint32_t breakpoint_read(Cpu* cpu, uint32_t r);
+char breakpoint_check(Cpu* cpu);
+void run_breakpoints(Cpu* cpu);
+
+#endif
@@ -1,8 +1,12 @@
 #include "cpu.h"
 
-void decode_and_execute(Cpu* cpu, Instruction instr) {
+#ifdef __x86_64__
+#include "jit/jit.h"
+#endif
+
+void decode_and_execute(Cpu* cpu, Decoded* instr) {
 	/* printf("instr: %x\n", instr); */
-	uint32_t i = instr_function(instr);
+	uint32_t i = instr_function(instr->word);
 	/* printf("instr opcode: %x\n", i); */
 	switch(i) {
 	case 0b001111:
@@ -130,40 +134,432 @@ void decode_and_execute(Cpu* cpu, Instruction instr) {
 	}
 }
 
+// primary opcodes, then the secondary ones at 64 + funct so any instruction
+// is dispatched with a single lookup
+const OpHandler HANDLERS[128] = {
+	[0b000000] = op_secondary,
+	[0b000001] = op_bcondz,
+	[0b000010] = op_j,
+	[0b000011] = op_jal,
+	[0b000100] = op_beq,
+	[0b000101] = op_bne,
+	[0b000110] = op_blez,
+	[0b000111] = op_bgtz,
+	[0b001000] = op_addi,
+	[0b001001] = op_addiu,
+	[0b001010] = op_slti,
+	[0b001011] = op_sltiu,
+	[0b001100] = op_andi,
+	[0b001101] = op_ori,
+	[0b001110] = op_xori,
+	[0b001111] = op_lui,
+	[0b010000] = op_cop0,
+	[0b010001] = op_cop1,
+	[0b010010] = op_cop2,
+	[0b010011] = op_cop3,
+	[0b010100] = op_illegal,
+	[0b010101] = op_illegal,
+	[0b010110] = op_illegal,
+	[0b010111] = op_illegal,
+	[0b011000] = op_illegal,
+	[0b011001] = op_illegal,
+	[0b011010] = op_illegal,
+	[0b011011] = op_illegal,
+	[0b011100] = op_illegal,
+	[0b011101] = op_illegal,
+	[0b011110] = op_illegal,
+	[0b011111] = op_illegal,
+	[0b100000] = op_lb,
+	[0b100001] = op_lh,
+	[0b100010] = op_lwl,
+	[0b100011] = op_lw,
+	[0b100100] = op_lbu,
+	[0b100101] = op_lhu,
+	[0b100110] = op_lwr,
+	[0b100111] = op_illegal,
+	[0b101000] = op_sb,
+	[0b101001] = op_sh,
+	[0b101010] = op_swl,
+	[0b101011] = op_sw,
+	[0b101100] = op_illegal,
+	[0b101101] = op_illegal,
+	[0b101110] = op_swr,
+	[0b101111] = op_illegal,
+	[0b110000] = op_lwc0,
+	[0b110001] = op_lwc1,
+	[0b110010] = op_lwc2,
+	[0b110011] = op_lwc3,
+	[0b110100] = op_illegal,
+	[0b110101] = op_illegal,
+	[0b110110] = op_illegal,
+	[0b110111] = op_illegal,
+	[0b111000] = op_swc0,
+	[0b111001] = op_swc1,
+	[0b111010] = op_swc2,
+	[0b111011] = op_swc3,
+	[0b111100] = op_illegal,
+	[0b111101] = op_illegal,
+	[0b111110] = op_illegal,
+	[0b111111] = op_illegal,
+
+	[64 + 0b000000] = op_sll,
+	[64 + 0b000001] = op_illegal,
+	[64 + 0b000010] = op_srl,
+	[64 + 0b000011] = op_sra,
+	[64 + 0b000100] = op_sllv,
+	[64 + 0b000101] = op_illegal,
+	[64 + 0b000110] = op_srlv,
+	[64 + 0b000111] = op_srav,
+	[64 + 0b001000] = op_jr,
+	[64 + 0b001001] = op_jalr,
+	[64 + 0b001010] = op_illegal,
+	[64 + 0b001011] = op_illegal,
+	[64 + 0b001100] = op_syscall,
+	[64 + 0b001101] = op_break,
+	[64 + 0b001110] = op_illegal,
+	[64 + 0b001111] = op_illegal,
+	[64 + 0b010000] = op_mfhi,
+	[64 + 0b010001] = op_mthi,
+	[64 + 0b010010] = op_mflo,
+	[64 + 0b010011] = op_mtlo,
+	[64 + 0b010100] = op_illegal,
+	[64 + 0b010101] = op_illegal,
+	[64 + 0b010110] = op_illegal,
+	[64 + 0b010111] = op_illegal,
+	[64 + 0b011000] = op_mult,
+	[64 + 0b011001] = op_multu,
+	[64 + 0b011010] = op_div,
+	[64 + 0b011011] = op_divu,
+	[64 + 0b011100] = op_illegal,
+	[64 + 0b011101] = op_illegal,
+	[64 + 0b011110] = op_illegal,
+	[64 + 0b011111] = op_illegal,
+	[64 + 0b100000] = op_add,
+	[64 + 0b100001] = op_addu,
+	[64 + 0b100010] = op_sub,
+	[64 + 0b100011] = op_subu,
+	[64 + 0b100100] = op_and,
+	[64 + 0b100101] = op_or,
+	[64 + 0b100110] = op_xor,
+	[64 + 0b100111] = op_nor,
+	[64 + 0b101000] = op_illegal,
+	[64 + 0b101001] = op_illegal,
+	[64 + 0b101010] = op_slt,
+	[64 + 0b101011] = op_sltu,
+	[64 + 0b101100] = op_illegal,
+	[64 + 0b101101] = op_illegal,
+	[64 + 0b101110] = op_illegal,
+	[64 + 0b101111] = op_illegal,
+	[64 + 0b110000] = op_illegal,
+	[64 + 0b110001] = op_illegal,
+	[64 + 0b110010] = op_illegal,
+	[64 + 0b110011] = op_illegal,
+	[64 + 0b110100] = op_illegal,
+	[64 + 0b110101] = op_illegal,
+	[64 + 0b110110] = op_illegal,
+	[64 + 0b110111] = op_illegal,
+	[64 + 0b111000] = op_illegal,
+	[64 + 0b111001] = op_illegal,
+	[64 + 0b111010] = op_illegal,
+	[64 + 0b111011] = op_illegal,
+	[64 + 0b111100] = op_illegal,
+	[64 + 0b111101] = op_illegal,
+	[64 + 0b111110] = op_illegal,
+	[64 + 0b111111] = op_illegal,
+};
+
+OpHandler op_handler(Instruction instr) {
+	uint32_t i = instr_function(instr);
+
+	switch(i) {
+	case 0b000000:
+		return HANDLERS[64 + instr_subfunction(instr)];
+	case 0b000001:
+		switch(instr_t(instr)) {
+		case 0b000000:
+			return op_bltz;
+		case 0b000001:
+			return op_bgez;
+		case 0b010000:
+			return op_bltzal;
+		case 0b010001:
+			return op_bgezal;
+		default:
+			return op_bcondz;
+		}
+	case 0b010000:
+		switch(instr_s(instr)) {
+		case 0b00100:
+			return op_mtc0;
+		case 0b00000:
+			return op_mfc0;
+		case 0b10000:
+			if (instr_subfunction(instr) == 0b010000) {
+				return op_rfe;
+			}
+			return op_cop0;
+		default:
+			return op_cop0;
+		}
+	default:
+		return HANDLERS[i];
+	}
+}
+
+// The block engines only check the icache at the first op of a line, so a
+// store that may drop a line ends the running block.
+void cpu_isolated_store(Cpu* cpu, uint32_t addr) {
+	icache_isolated_store(&cpu->icache, addr);
+
+	if (cpu->cache != NULL) {
+		cpu->cache->dirty = 1;
+	}
+}
+
+void cpu_icache_fetch(Cpu* cpu, Decoded* instr) {
+	cpu->cycles += icache_fetch(&cpu->icache, cpu->regions, instr->pc);
+}
+
+// data accesses pay for their region with a table lookup, no branches
+
 uint32_t cpu_load32(Cpu* cpu, uint32_t addr) {   
+	cpu->cycles += LOAD_CYCLES[2][cpu->regions[addr >> TIMING_PAGE_SHIFT]];
 	return intr_load32(cpu->intr, addr);
 }
 
 uint32_t cpu_load16(Cpu* cpu, uint32_t addr) {
+	cpu->cycles += LOAD_CYCLES[1][cpu->regions[addr >> TIMING_PAGE_SHIFT]];
 	return intr_load16(cpu->intr, addr);
 }
 
 uint8_t cpu_load8(Cpu* cpu, uint32_t addr) {
+	cpu->cycles += LOAD_CYCLES[0][cpu->regions[addr >> TIMING_PAGE_SHIFT]];
 	return intr_load8(cpu->intr, addr);
 }
 
 void cpu_store32(Cpu* cpu, uint32_t addr, uint32_t v) {
 	if ((cpu->sr & 0x10000) != 0) {
-		/* printf("ignore store while cache is isolated\n"); */
+		cpu_isolated_store(cpu, addr);
 		return;
 	}
+	cpu->cycles += STORE_CYCLES[2][cpu->regions[addr >> TIMING_PAGE_SHIFT]];
 	intr_store32(cpu->intr, addr, v);
+
+	if (cpu->cache != NULL) {
+		block_cache_invalidate(cpu->cache, addr);
+	}
 }
 
 void cpu_store16(Cpu* cpu, uint32_t addr, uint16_t v) {
 	if ((cpu->sr & 0x10000) != 0) {
-		/* printf("ignore store while cache is isolated\n"); */
+		cpu_isolated_store(cpu, addr);
 		return;
 	}    
+	cpu->cycles += STORE_CYCLES[1][cpu->regions[addr >> TIMING_PAGE_SHIFT]];
 	intr_store16(cpu->intr, addr, v);
+
+	if (cpu->cache != NULL) {
+		block_cache_invalidate(cpu->cache, addr);
+	}
 }
 
 void cpu_store8(Cpu* cpu, uint32_t addr, uint8_t v) {
 	if ((cpu->sr & 0x10000) != 0) {
-		/* printf("ignore store while cache is isolated\n"); */
+		cpu_isolated_store(cpu, addr);
 		return;
 	}    
+	cpu->cycles += STORE_CYCLES[0][cpu->regions[addr >> TIMING_PAGE_SHIFT]];
 	intr_store8(cpu->intr, addr, v);
+
+	if (cpu->cache != NULL) {
+		block_cache_invalidate(cpu->cache, addr);
+	}
+}
+
+// Runs for at most cycles, stopping early when a scheduler event is due or
+// something asked for the host through cpu_stop. Events are left for the
+// caller to run.
+CpuExit cpu_run_for(Cpu* cpu, uint64_t cycles) {
+	Scheduler* s = cpu->intr->scheduler;
+
+	cpu->exit = CPU_EXIT_BUDGET;
+	cpu->deadline = cpu->cycles + cycles;
+
+	if (scheduler_next(s) < cpu->deadline) {
+		cpu->deadline = scheduler_next(s);
+	}
+
+	// events scheduled while running pull the deadline in
+	s->deadline = &cpu->deadline;
+
+	while (cpu->cycles < cpu->deadline) {
+		switch (cpu->mode) {
+		case CPU_MODE_CACHED:
+			run_next_block(cpu);
+			break;
+#ifdef __x86_64__
+		case CPU_MODE_JIT:
+			run_next_jit_block(cpu);
+			break;
+#endif
+		case CPU_MODE_PROFILE:
+			run_profiled(cpu);
+			break;
+		case CPU_MODE_TRACE:
+			run_traced(cpu);
+			break;
+		case CPU_MODE_DEBUG:
+			run_breakpoints(cpu);
+			break;
+		default:
+			run_instructions(cpu);
+		}
+
+		// the loop returned because the mode changed under it
+		if (cpu->resume != 0) {
+			cpu->deadline = cpu->resume;
+			cpu->resume = 0;
+		}
+	}
+
+	s->deadline = NULL;
+
+	if (cpu->exit != CPU_EXIT_BUDGET) {
+		return cpu->exit;
+	}
+
+	if (scheduler_next(s) <= cpu->cycles) {
+		return CPU_EXIT_EVENT;
+	}
+
+	return CPU_EXIT_BUDGET;
+}
+
+void cpu_stop(Cpu* cpu, CpuExit reason) {
+	cpu->exit = reason;
+	cpu->deadline = 0;
+}
+
+// makes the running loop return to cpu_run_for, which carries on with the
+// loop of the current mode
+void cpu_yield(Cpu* cpu) {
+	cpu->resume = cpu->deadline;
+	cpu->deadline = cpu->cycles;
+}
+
+// pc must be word aligned. Only RAM and BIOS pages are cached, their host
+// memory never moves once the machine is running.
+// predecoded instructions of the 64 kB page holding phys, allocated on first use
+Decoded* cpu_decoded_page(Cpu* cpu, uint32_t phys) {
+	uint32_t index = phys >> MEM_PAGE_SHIFT;
+
+	if (cpu->decoded[index] == NULL) {
+		Decoded* page = malloc(DECODED_PAGE_OPS * sizeof(Decoded));
+
+		for (int i = 0; i < DECODED_PAGE_OPS; ++i) {
+			page[i].pc = DECODED_NONE;
+		}
+
+		cpu->decoded[index] = page;
+	}
+
+	return cpu->decoded[index];
+}
+
+// instr_decode plus what the instruction costs, the fetch depends on where
+// it runs from
+void cpu_decode(Cpu* cpu, Decoded* op, Instruction word, uint32_t pc) {
+	instr_decode(op, word, pc);
+
+	op->cycles = timing_fetch_cycles(cpu->regions, pc);
+	op->icache = pc < ICACHE_UNCACHED;
+
+	if (op->id == 0b010010 && (word & (1 << 25)) != 0) {
+		op->cycles += timing_gte_cycles(word);
+	}
+}
+
+// refills the fetch cache or runs a hook, returns the entry the instruction
+// is decoded into
+Decoded* cpu_fetch_miss(Cpu* cpu, Instruction* word) {
+	uint32_t pc = cpu->pc;
+
+	cpu->fetch_misses += 1;
+	cpu->fetch_tag = FETCH_NONE;
+
+	// the page of the shell entry stays out of the fetch cache while an exe
+	// waits to be loaded, so the entry gets here
+	if (cpu->exe != NULL && mask_region(pc) >> MEM_PAGE_SHIFT == mask_region(EXE_SHELL_ENTRY) >> MEM_PAGE_SHIFT) {
+		*word = exe_hook(cpu, mask_region(pc)) == 1 ? 0 : intr_load32(cpu->intr, pc);
+		return &cpu->fetch_uncached;
+	}
+
+	MemPage* page = intr_page(cpu->intr, mask_region(pc));
+
+	if (page == NULL || page->read == NULL) {
+		*word = intr_load32(cpu->intr, pc);
+		return &cpu->fetch_uncached;
+	}
+
+	cpu->fetch_tag = pc >> MEM_PAGE_SHIFT;
+	cpu->fetch_page = page->read;
+	cpu->fetch_decoded = cpu_decoded_page(cpu, mask_region(pc));
+
+	memcpy(word, cpu->fetch_page + (pc & MEM_PAGE_MASK), 4);
+	return &cpu->fetch_decoded[(pc & MEM_PAGE_MASK) >> 2];
+}
+
+Decoded* cpu_fetch(Cpu* cpu) {
+	uint32_t pc = cpu->pc;
+	Instruction word;
+	Decoded* op;
+
+	// kernel calls are caught at the three vectors only, the rest of the
+	// kernel page keeps the fast path
+	if (cpu->hle != NULL && hle_vector(cpu) == 1) {
+		cpu->fetch_misses += 1;
+		word = hle_call(cpu, mask_region(pc)) == 1 ? 0 : intr_load32(cpu->intr, pc);
+		op = &cpu->fetch_uncached;
+	} else if ((pc >> MEM_PAGE_SHIFT) == cpu->fetch_tag) {
+		cpu->fetch_hits += 1;
+		memcpy(&word, cpu->fetch_page + (pc & MEM_PAGE_MASK), 4);
+		op = &cpu->fetch_decoded[(pc & MEM_PAGE_MASK) >> 2];
+	} else {
+		op = cpu_fetch_miss(cpu, &word);
+	}
+
+	// decoded on first use, and again once the code was overwritten
+	if (op->pc != pc || op->word != word) {
+		cpu_decode(cpu, op, word, pc);
+	}
+
+	if (op->icache == 1) {
+		cpu_icache_fetch(cpu, op);
+	}
+
+	return op;
+}
+
+// reads RAM or BIOS without side effects, 0 for anything else
+uint32_t cpu_peek32(Cpu* cpu, uint32_t addr) {
+	MemPage* page = intr_page(cpu->intr, mask_region(addr));
+	uint32_t v = 0;
+
+	if (page != NULL && page->read != NULL && addr % 4 == 0) {
+		memcpy(&v, page->read + (addr & MEM_PAGE_MASK), 4);
+	}
+
+	return v;
+}
+
+// the block engines step hooked addresses with the interpreter so the fetch
+// path sees them
+char cpu_fetch_hooked(Cpu* cpu) {
+	if (hle_vector(cpu) == 1) {
+		return 1;
+	}
+
+	return cpu->exe != NULL && mask_region(cpu->pc) == mask_region(EXE_SHELL_ENTRY);
 }
 
 void run_next_instruction(Cpu* cpu) {        
@@ -173,23 +569,30 @@ void run_next_instruction(Cpu* cpu) {
 		return exception(cpu, LOAD_BUS);
 	}
 
-	Instruction instr = cpu_load32(cpu, cpu->pc);
+	Decoded* instr = cpu_fetch(cpu);
    	       
+	cpu->cycles += instr->cycles;
+
 	cpu->pc = cpu->next_pc;
 	cpu->next_pc += 4;
-        
-	set_reg(cpu, cpu->load[0], cpu->load[1]);
-	cpu->load[0] = 0;
-	cpu->load[1] = 0;          	
 
 	cpu->delay_slot = cpu->branch;
 	cpu->branch = 0;
 	
 	decode_and_execute(cpu, instr);
 
-	for (int i = 0; i < 32; ++i) {
-		cpu->regs[i] = cpu->out[i];		
-	}	
+	retire_load(cpu);
+}
+
+// write back the load issued by the previous instruction, queue the one issued by this one
+void retire_load(Cpu* cpu) {
+	cpu->regs[cpu->load[0]] = cpu->load[1];
+	cpu->regs[0] = 0;
+
+	cpu->load[0] = cpu->next_load[0];
+	cpu->load[1] = cpu->next_load[1];
+	cpu->next_load[0] = 0;
+	cpu->next_load[1] = 0;
 }
 
 void exception(Cpu* cpu, Exception cause) {
@@ -201,6 +604,11 @@ void exception(Cpu* cpu, Exception cause) {
 		handler = 0x80000080;
 	}
 
+	exception_vector(cpu, cause, handler);
+}
+
+// debug breaks enter through their own vector, everything else is shared
+void exception_vector(Cpu* cpu, Exception cause, uint32_t handler) {
 	uint32_t mode = cpu->sr & 0x3f;
 	cpu->sr &= ~0x3f;
 	cpu->sr |= (mode << 2) & 0x3f;
@@ -208,6 +616,7 @@ void exception(Cpu* cpu, Exception cause) {
 	cpu->cause = cause << 2;
     
 	cpu->epc = cpu->curr_pc;
+	idle_leave(cpu);
 
 	if(cpu->delay_slot == 1) {
 		cpu->epc -= 4;
@@ -223,14 +632,27 @@ Cpu* initialize_cpu(Interconnect* intr) {
 
 	// $zero register        
 	cpu->regs[0] = 0;
-	cpu->out[0] = 0;
 	for (int i = 1; i < 32; i++) {
 		cpu->regs[i] = GARBAGE_VALUE;
-		cpu->out[i] = GARBAGE_VALUE;
 	}
 
+	gte_reset(&cpu->gte);
+	initialize_breakpoints(&cpu->breakpoints);
+	icache_reset(&cpu->icache);
+
+	cpu->muldiv_ready = 0;
+	cpu->regions = initialize_timing_regions();
+
 	cpu->load[0] = 0;
 	cpu->load[1] = 0;
+	cpu->next_load[0] = 0;
+	cpu->next_load[1] = 0;
+
+	cpu->cycles = 0;
+	cpu->deadline = 0;
+	cpu->resume = 0;
+	cpu->exit = CPU_EXIT_BUDGET;
+	initialize_idle(&cpu->idle);
 
 	cpu->hi = GARBAGE_VALUE;
 	cpu->lo = GARBAGE_VALUE;
@@ -238,6 +660,26 @@ Cpu* initialize_cpu(Interconnect* intr) {
 	cpu->pc = RESET;
 	cpu->next_pc = cpu->pc + 4;
 	cpu->intr = intr;
+	cpu->fetch_tag = FETCH_NONE;
+	cpu->fetch_page = NULL;
+	cpu->fetch_decoded = NULL;
+	cpu->fetch_uncached.pc = DECODED_NONE;
+	cpu->fetch_hits = 0;
+	cpu->fetch_misses = 0;
+	cpu->block_ops = 0;
+	cpu->mode = CPU_MODE_INTERPRETER;
+	cpu->dispatch = DISPATCH_THREADED;
+	cpu->cache = NULL;
+	cpu->jit = NULL;
+	cpu->hle = NULL;
+	cpu->exe = NULL;
+	cpu->profile = NULL;
+	cpu->trace = NULL;
+
+	for (int i = 0; i < MEM_PAGE_COUNT; ++i) {
+		cpu->decoded[i] = NULL;
+	}
+
 	return cpu;
 }
 
@@ -260,12 +702,17 @@ uint32_t get_reg(Cpu* cpu, uint32_t index) {
 }
 
 void set_reg(Cpu* cpu, uint32_t index, uint32_t v) {
-	cpu->out[index] = v;
-	cpu->out[0] = 0;
+	cpu->regs[index] = v;
+	cpu->regs[0] = 0;
+
+	// a write by the instruction in the load delay slot wins over the load
+	if (cpu->load[0] == index) {
+		cpu->load[0] = 0;
+	}
 }
 
-void op_secondary(Cpu* cpu, Instruction instr) {
-	uint32_t i = instr_subfunction(instr);
+void op_secondary(Cpu* cpu, Decoded* instr) {
+	uint32_t i = instr_subfunction(instr->word);
 
 	/* printf("secondary instr op code: %x\n", i); */
 	switch(i) {
@@ -358,8 +805,8 @@ void op_secondary(Cpu* cpu, Instruction instr) {
 	}
 }
 
-void op_bcondz(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
+void op_bcondz(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
 
 	switch(t) {
 	case 0b000000:
@@ -380,29 +827,29 @@ void op_bcondz(Cpu* cpu, Instruction instr) {
 	}
 }
 
-void op_lui(Cpu* cpu, Instruction instr) {
-	uint32_t i = instr_imm(instr);
-	uint32_t t = instr_t(instr);
+void op_lui(Cpu* cpu, Decoded* instr) {
+	uint32_t i = instr->imm;
+	uint32_t t = instr->t;
 
 	uint32_t v = i << 16;
 	
 	set_reg(cpu, t, v);
 }
 
-void op_ori(Cpu* cpu, Instruction instr) {
-	uint32_t i = instr_imm(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
+void op_ori(Cpu* cpu, Decoded* instr) {
+	uint32_t i = instr->imm;
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
 
 	uint32_t v = get_reg(cpu, s) | i;
 
 	set_reg(cpu, t, v);
 }
 
-void op_sw(Cpu* cpu, Instruction instr) {	    
-	uint32_t i = instr_imm_se(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
+void op_sw(Cpu* cpu, Decoded* instr) {	    
+	uint32_t i = instr->imm_se;
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
     
 	uint32_t addr = get_reg(cpu, s) + i;
 
@@ -415,77 +862,77 @@ void op_sw(Cpu* cpu, Instruction instr) {
 	cpu_store32(cpu, addr, v);
 }
 
-void op_sll(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t d = instr_d(instr);
-	uint32_t i = instr_shift(instr);
+void op_sll(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t d = instr->d;
+	uint32_t i = instr->shift;
     
 	uint32_t v = get_reg(cpu, t) << i;
 
 	set_reg(cpu, d, v);
 }
 
-void op_addiu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_addiu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
    
 	uint32_t v = get_reg(cpu, s) + i;        
 	
 	set_reg(cpu, t, v);
 }
 
-void op_j(Cpu* cpu, Instruction instr) {
-	uint32_t j = instr_imm_jump(instr) << 2;
-
+void op_j(Cpu* cpu, Decoded* instr) {
 	cpu->branch = 1;
-	cpu->next_pc = (cpu->pc & 0xf0000000) | j;
+	cpu->next_pc = instr->target;
+
+	idle_leave(cpu);
 }
 
-void op_or(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_or(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, s) | get_reg(cpu, t);
 
 	set_reg(cpu, d, v);
 }
 
-void op_sltu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_sltu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, s) < get_reg(cpu, t);
 
 	set_reg(cpu, d, v);
 }
 
-void op_addu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_addu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, s) + get_reg(cpu, t);
 
 	set_reg(cpu, d, v);
 }
 
-void op_and(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_and(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, t) & get_reg(cpu, s);
     
 	set_reg(cpu, d, v);
 }
 
-void op_add(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_add(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	if (check_overflow(cpu, get_reg(cpu, t), get_reg(cpu, s)) == 1) {
 		return exception(cpu, OVERFLOW);
@@ -496,36 +943,43 @@ void op_add(Cpu* cpu, Instruction instr) {
 	set_reg(cpu, d, v);
 }
 
-void op_jalr(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_jalr(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
+
+	uint32_t target = get_reg(cpu, s);
 
 	set_reg(cpu, d, cpu->next_pc);
 	cpu->branch = 1;
-	cpu->next_pc = get_reg(cpu, s);    
+	cpu->next_pc = target;
 }
 
-void branch(Cpu* cpu, uint32_t offset) {
-	uint32_t v = offset << 2;
-
+void branch(Cpu* cpu, uint32_t target) {
 	cpu->branch = 1;
-	cpu->next_pc = cpu->pc + v;
+	cpu->next_pc = target;
+
+	if (target < cpu->pc) {
+		idle_branch(cpu, target);
+	} else {
+		idle_leave(cpu);
+	}
 }
 
-void op_bne(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_bne(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
     
 	if (get_reg(cpu, s) != get_reg(cpu, t)) {
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_addi(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_addi(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
     
 	if(check_overflow(cpu, get_reg(cpu, s), i) == 1) {	
 		return exception(cpu, OVERFLOW);
@@ -536,10 +990,10 @@ void op_addi(Cpu* cpu, Instruction instr) {
 	set_reg(cpu, t, v);    
 }
 
-void op_lw(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lw(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 
@@ -549,14 +1003,14 @@ void op_lw(Cpu* cpu, Instruction instr) {
     
 	uint32_t v = cpu_load32(cpu, addr);
 
-	cpu->load[0] = t;
-	cpu->load[1] = v;    
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = v;    
 }
 
-void op_sh(Cpu* cpu, Instruction instr) {
-	uint32_t i = instr_imm_se(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
+void op_sh(Cpu* cpu, Decoded* instr) {
+	uint32_t i = instr->imm_se;
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
     
 	uint32_t addr = get_reg(cpu, s) + i;    
 
@@ -569,7 +1023,7 @@ void op_sh(Cpu* cpu, Instruction instr) {
 	cpu_store16(cpu, addr, (uint16_t)v);
 }
 
-void op_jal(Cpu* cpu, Instruction instr) {
+void op_jal(Cpu* cpu, Decoded* instr) {
 	uint32_t ra = cpu->next_pc;
 
 	set_reg(cpu, 31, ra);
@@ -578,20 +1032,20 @@ void op_jal(Cpu* cpu, Instruction instr) {
 	cpu->branch = 1;
 }
 
-void op_andi(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm(instr);
+void op_andi(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm;
 
 	uint32_t v = get_reg(cpu, s) & i;
     
 	set_reg(cpu, t, v);
 }
 
-void op_sb(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_sb(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;    
 	uint32_t v = get_reg(cpu, t);
@@ -599,133 +1053,145 @@ void op_sb(Cpu* cpu, Instruction instr) {
 	cpu_store8(cpu, addr, (uint8_t)v);
 }
 
-void op_jr(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
+void op_jr(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
 
 	cpu->branch = 1;
 	cpu->next_pc = get_reg(cpu, s);
 }
 
-void op_lb(Cpu* cpu, Instruction instr) {    
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lb(Cpu* cpu, Decoded* instr) {    
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
     
 	uint32_t addr = get_reg(cpu, s) + i;
 	int8_t v = cpu_load8(cpu, addr);
 
-	cpu->load[0] = t;
-	cpu->load[1] = (uint32_t)v;
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = (uint32_t)v;
 }
 
-void op_beq(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_beq(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
 
 	if (get_reg(cpu, s) == get_reg(cpu, t)) {
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_bgtz(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_bgtz(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
     
 	if((int32_t)get_reg(cpu, s) > 0) {
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_blez(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_blez(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
 
 	if((int32_t)get_reg(cpu, s) <= 0) {
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_lbu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lbu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
     
 	uint32_t addr = get_reg(cpu, s) + i;
 	uint8_t v = cpu_load8(cpu, addr);
 
-	cpu->load[0] = t;
-	cpu->load[1] = (uint32_t)v;
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = (uint32_t)v;
 }
 
-void op_bltz(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_bltz(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
     
 	if((int32_t)get_reg(cpu, s) < 0) {
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_bgez(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_bgez(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
     
 	if((int32_t)get_reg(cpu, s) >= 0) {
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_bltzal(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);        
+void op_bltzal(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	int32_t v = get_reg(cpu, s);
 	set_reg(cpu, 31, cpu->next_pc);
-	if((int32_t)get_reg(cpu, s) < 0) {	
-		branch(cpu, i);
+	if(v < 0) {	
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_bgezal(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);    
+void op_bgezal(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	int32_t v = get_reg(cpu, s);
 	set_reg(cpu, 31, cpu->next_pc);
-	if((int32_t)get_reg(cpu, s) >= 0) {
+	if(v >= 0) {
 	
-		branch(cpu, i);
+		branch(cpu, instr->target);
+	} else {
+		idle_leave(cpu);
 	}
 }
 
-void op_slti(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_slti(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+	uint32_t i = instr->imm_se;
 
 	uint32_t v = (int32_t)get_reg(cpu, s) < (int32_t)i;
 	set_reg(cpu, t, v);
 }
 
-void op_subu(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t d = instr_d(instr);
+void op_subu(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, s) - get_reg(cpu, t);
 	set_reg(cpu, d, v);
 }
 
-void op_sra(Cpu* cpu, Instruction instr) {
-	uint32_t i = instr_shift(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t d = instr_d(instr);
+void op_sra(Cpu* cpu, Decoded* instr) {
+	uint32_t i = instr->shift;
+	uint32_t t = instr->t;
+	uint32_t d = instr->d;
 
 	uint32_t v = ((int32_t)get_reg(cpu, t)) >> i;
 
 	set_reg(cpu, d, v);
 }
 
-void op_div(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t t = instr_t(instr);
+void op_div(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+
+	muldiv_wait(cpu);
+	cpu->muldiv_ready = cpu->cycles + DIV_CYCLES;
 
 	int32_t n = get_reg(cpu, s);
 	int32_t d = get_reg(cpu, t);
@@ -747,36 +1213,38 @@ void op_div(Cpu* cpu, Instruction instr) {
 	}    
 }
 
-void op_mflo(Cpu* cpu, Instruction instr) {
-	uint32_t d = instr_d(instr);
+void op_mflo(Cpu* cpu, Decoded* instr) {
+	uint32_t d = instr->d;
+
+	muldiv_wait(cpu);
 
 	set_reg(cpu, d, cpu->lo);
 }
 
-void op_srl(Cpu* cpu, Instruction instr) {
-	uint32_t d = instr_d(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t i = instr_shift(instr);
+void op_srl(Cpu* cpu, Decoded* instr) {
+	uint32_t d = instr->d;
+	uint32_t t = instr->t;
+	uint32_t i = instr->shift;
 
 	uint32_t v = get_reg(cpu, t) >> i;
 
 	set_reg(cpu, d, v);
 }
 
-void op_sltiu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_sltiu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t v = get_reg(cpu, s) < i;
 
 	set_reg(cpu, t, v);
 }
 
-void op_lhu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lhu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 
@@ -786,28 +1254,29 @@ void op_lhu(Cpu* cpu, Instruction instr) {
     
 	uint32_t v = cpu_load16(cpu, addr);
 
-	cpu->load[0] = t;
-	cpu->load[1] = v;
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = v;
 }
 
-void op_xori(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm(instr);
+void op_xori(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm;
 
 	uint32_t v = get_reg(cpu, s) ^ i;
 
 	set_reg(cpu, t, v);
 }
 
-void op_lwl(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lwl(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 
-	uint32_t cur_v = cpu->out[t];
+	// lwl/lwr merge with a load still in its delay slot
+	uint32_t cur_v = cpu->load[0] == t ? cpu->load[1] : cpu->regs[t];
 
 	uint32_t aligned_addr = addr & ~3;
 	uint32_t aligned_word = cpu_load32(cpu, aligned_addr);
@@ -832,18 +1301,19 @@ void op_lwl(Cpu* cpu, Instruction instr) {
 		exit(1);
 	}
 
-	cpu->load[0] = t;
-	cpu->load[1] = v;
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = v;
 }
 
-void op_lwr(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lwr(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 
-	uint32_t cur_v = cpu->out[t];
+	// lwl/lwr merge with a load still in its delay slot
+	uint32_t cur_v = cpu->load[0] == t ? cpu->load[1] : cpu->regs[t];
 
 	uint32_t aligned_addr = addr & ~3;
 	uint32_t aligned_word = cpu_load32(cpu, aligned_addr);
@@ -868,14 +1338,14 @@ void op_lwr(Cpu* cpu, Instruction instr) {
 		exit(1);
 	}
 
-	cpu->load[0] = t;
-	cpu->load[1] = v;
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = v;
 }
 
-void op_swl(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_swl(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 	uint32_t v = get_reg(cpu, t);
@@ -905,10 +1375,10 @@ void op_swl(Cpu* cpu, Instruction instr) {
 	cpu_store32(cpu, aligned_addr, word);
 }
 
-void op_swr(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_swr(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 	uint32_t v = get_reg(cpu, t);
@@ -938,13 +1408,16 @@ void op_swr(Cpu* cpu, Instruction instr) {
 	cpu_store32(cpu, aligned_addr, word);
 }
 
-void op_illegal(Cpu* cpu, Instruction instr) {
+void op_illegal(Cpu* cpu, Decoded* instr) {
 	exception(cpu, ILLEGAL);
 }
 
-void op_divu(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t t = instr_t(instr);
+void op_divu(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+
+	muldiv_wait(cpu);
+	cpu->muldiv_ready = cpu->cycles + DIV_CYCLES;
 
 	uint32_t n = get_reg(cpu, s);
 	uint32_t d = get_reg(cpu, t);
@@ -958,42 +1431,44 @@ void op_divu(Cpu* cpu, Instruction instr) {
 	}
 }
 
-void op_mfhi(Cpu* cpu, Instruction instr) {
-	uint32_t d = instr_d(instr);
+void op_mfhi(Cpu* cpu, Decoded* instr) {
+	uint32_t d = instr->d;
+
+	muldiv_wait(cpu);
 
 	set_reg(cpu, d, cpu->hi);
 }
 
-void op_slt(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t d = instr_d(instr);
+void op_slt(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+	uint32_t d = instr->d;
     
 	uint32_t v = (int32_t)get_reg(cpu, s) < (int32_t)get_reg(cpu, t);
 
 	set_reg(cpu, d, v);
 }
 
-void op_syscall(Cpu* cpu, Instruction instr) {
+void op_syscall(Cpu* cpu, Decoded* instr) {
 	exception(cpu, SYSCALL);
 }
 
-void op_mtlo(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
+void op_mtlo(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
     
 	cpu->lo = get_reg(cpu, s);
 }
 
-void op_mthi(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
+void op_mthi(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
 
 	cpu->hi = get_reg(cpu, s);
 }
 
-void op_rfe(Cpu* cpu, Instruction instr) {
+void op_rfe(Cpu* cpu, Decoded* instr) {
 
-	if (instr & 0x3f != 0b010000) {
-		printf("Invalid cop0 instruction: %x\n", instr);
+	if (instr->word & 0x3f != 0b010000) {
+		printf("Invalid cop0 instruction: %x\n", instr->word);
 		exit(1);
 	}
 
@@ -1002,59 +1477,62 @@ void op_rfe(Cpu* cpu, Instruction instr) {
 	cpu->sr |= mode >> 2;
 }
 
-void op_sllv(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_sllv(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, t) << (get_reg(cpu, s) & 0x1f);
 
 	set_reg(cpu, d, v);
 }
 
-void op_lh(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t i = instr_imm_se(instr);
+void op_lh(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t i = instr->imm_se;
 
 	uint32_t addr = get_reg(cpu, s) + i;
 
 	int16_t v = cpu_load16(cpu, addr);
 
-	cpu->load[0] = t;
-	cpu->load[1] = (uint32_t)v;
+	cpu->next_load[0] = t;
+	cpu->next_load[1] = (uint32_t)v;
 }
 
-void op_nor(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_nor(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = ~(get_reg(cpu, s) | get_reg(cpu, t));
 	set_reg(cpu, d, v);
 }
 
-void op_srav(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_srav(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = (int32_t)get_reg(cpu, t) >> (get_reg(cpu, s) & 0x1f);
 	set_reg(cpu, d, v);
 }
 
-void op_srlv(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_srlv(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, t) >> (get_reg(cpu, s) & 0x1f);
 	set_reg(cpu, d, v);
 }
 
-void op_multu(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
+void op_multu(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+
+	muldiv_wait(cpu);
+	cpu->muldiv_ready = cpu->cycles + timing_mult_cycles(get_reg(cpu, s), 0);
 
 	uint64_t v = (uint64_t)get_reg(cpu, t) * (uint64_t)get_reg(cpu, s);
 
@@ -1062,23 +1540,35 @@ void op_multu(Cpu* cpu, Instruction instr) {
 	cpu->lo = (uint32_t)v;
 }
 
-void op_xor(Cpu* cpu, Instruction instr) {
-	uint32_t s = instr_s(instr);
-	uint32_t t = instr_t(instr);
-	uint32_t d = instr_d(instr);
+void op_xor(Cpu* cpu, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+	uint32_t d = instr->d;
 
 	uint32_t v = get_reg(cpu, s) ^ get_reg(cpu, t);
 
 	set_reg(cpu, d, v);
 }
 
-void op_break(Cpu* cpu, Instruction instr) {
+void op_break(Cpu* cpu, Decoded* instr) {
 	exception(cpu, BREAK);
+	cpu_stop(cpu, CPU_EXIT_BREAK);
+}
+
+// hi/lo are only written when the unit is done, reading them or starting
+// another mult/div earlier stalls
+void muldiv_wait(Cpu* cpu) {
+	if (cpu->cycles < cpu->muldiv_ready) {
+		cpu->cycles = cpu->muldiv_ready;
+	}
 }
 
-void op_mult(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
+void op_mult(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+
+	muldiv_wait(cpu);
+	cpu->muldiv_ready = cpu->cycles + timing_mult_cycles(get_reg(cpu, s), 1);
 
 	uint64_t v = (int64_t)get_reg(cpu, t) * (int64_t)get_reg(cpu, s);
 
@@ -1086,10 +1576,10 @@ void op_mult(Cpu* cpu, Instruction instr) {
 	cpu->lo = (uint32_t)v;
 }
 
-void op_sub(Cpu* cpu, Instruction instr) {
-	uint32_t t = instr_t(instr);
-	uint32_t s = instr_s(instr);
-	uint32_t d = instr_d(instr);
+void op_sub(Cpu* cpu, Decoded* instr) {
+	uint32_t t = instr->t;
+	uint32_t s = instr->s;
+	uint32_t d = instr->d;
 
 	if(check_overflow(cpu, get_reg(cpu, s), get_reg(cpu, t)) == 1) {
 		return exception(cpu, OVERFLOW);		
@@ -1100,8 +1590,8 @@ void op_sub(Cpu* cpu, Instruction instr) {
 	set_reg(cpu, d, v);
 }
 
-void op_cop0(Cpu* cpu, Instruction instr) {
-	uint32_t i = instr_s(instr);
+void op_cop0(Cpu* cpu, Decoded* instr) {
+	uint32_t i = instr->s;
 	/* printf("cop0 instr code: %x\n", i); */
     
 	switch(i) {
@@ -1112,7 +1602,7 @@ void op_cop0(Cpu* cpu, Instruction instr) {
 		op_mfc0(cpu, instr);
 		break;
 	case 0b10000:
-		i = instr_subfunction(instr);
+		i = instr_subfunction(instr->word);
 
 		switch(i) {
 		case 0b010000:
@@ -1129,64 +1619,76 @@ void op_cop0(Cpu* cpu, Instruction instr) {
 	}
 }
 
-void op_cop1(Cpu* cpu, Instruction instr) {
+void op_cop1(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_cop2(Cpu* cpu, Instruction instr) {
-    
-	printf("unhandled gte\n");
-	exit(1);
+// the gte is only usable once the CU2 bit of SR is set
+char cop2_enabled(Cpu* cpu) {
+	return (cpu->sr & (1 << 30)) != 0;
+}
+
+void op_cop2(Cpu* cpu, Decoded* instr) {
+	if (cop2_enabled(cpu) == 0) {
+		return exception(cpu, COPROCESSOR_ERROR);
+	}
+
+	if ((instr->word & (1 << 25)) != 0) {
+		return gte_command(&cpu->gte, instr->word);
+	}
+
+	switch (instr->s) {
+	case 0b00000: // mfc2
+		cpu->next_load[0] = instr->t;
+		cpu->next_load[1] = gte_read_data(&cpu->gte, instr->d);
+		break;
+	case 0b00010: // cfc2
+		cpu->next_load[0] = instr->t;
+		cpu->next_load[1] = gte_read_control(&cpu->gte, instr->d);
+		break;
+	case 0b00100: // mtc2
+		gte_write_data(&cpu->gte, instr->d, get_reg(cpu, instr->t));
+		break;
+	case 0b00110: // ctc2
+		gte_write_control(&cpu->gte, instr->d, get_reg(cpu, instr->t));
+		break;
+	default:
+		printf("unknown cop2 instr: %x\n", instr->s);
+		exit(1);
+	}
 }
 
-void op_cop3(Cpu* cpu, Instruction instr) {
+void op_cop3(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_mtc0(Cpu* cpu, Instruction instr) {
-	uint32_t cpu_r = instr_t(instr);
-	uint32_t cop_r = instr_d(instr);
+void op_mtc0(Cpu* cpu, Decoded* instr) {
+	uint32_t cpu_r = instr->t;
+	uint32_t cop_r = instr->d;
 
 	uint32_t v = get_reg(cpu, cpu_r);
 
 	switch(cop_r) {
-	case 3:
-		if (v != 0) {
-	    printf("invalid mtc0 BPC register value: %x\n", v);
-	    exit(1);
-		}
-		break;
-	case 5:
-		if (v != 0) {
-	    printf("invalid mtc0 BDA register value: %x\n", v);
-	    exit(1);
-		}
-		break;
 	case 6:
 		if (v != 0) {
 	    printf("invalid mtc0 6 register value: %x\n", v);
 	    exit(1);
 		}
 		break;
+	case 3:
+	case 5:
 	case 7:
-		if (v != 0) {
-	    printf("invalid mtc0 DCIC register value: %x\n", v);
-	    exit(1);
-		}
-		break;
 	case 9:
-		if (v != 0) {
-	    printf("invalid mtc0 BDAM register value: %x\n", v);
-	    exit(1);
-		}
-		break;
 	case 11:
-		if (v != 0) {
-	    printf("invalid mtc0 BPCM register value: %x\n", v);
-	    exit(1);
-		}
+		breakpoint_write(cpu, cop_r, v);
 		break;
 	case 12:
+		// leaving cache isolation ends the BIOS icache flush, new code is
+		// about to run so it's a good time to drop the blocks it replaced
+		if ((cpu->sr & 0x10000) != 0 && (v & 0x10000) == 0 && cpu->cache != NULL) {
+			cpu->cache->collect = 1;
+		}
+
 		cpu->sr = v;
 		break;
 	case 13:
@@ -1201,13 +1703,20 @@ void op_mtc0(Cpu* cpu, Instruction instr) {
 	}
 }
 
-void op_mfc0(Cpu* cpu, Instruction instr) {
-	uint32_t cpu_r = instr_t(instr);
-	uint32_t cop_r = instr_d(instr);
+void op_mfc0(Cpu* cpu, Decoded* instr) {
+	uint32_t cpu_r = instr->t;
+	uint32_t cop_r = instr->d;
 
 	uint32_t v;
     
 	switch(cop_r) {
+	case 3:
+	case 5:
+	case 7:
+	case 9:
+	case 11:
+		v = breakpoint_read(cpu, cop_r);
+		break;
 	case 12:
 		v = cpu->sr;
 		break;
@@ -1222,40 +1731,58 @@ void op_mfc0(Cpu* cpu, Instruction instr) {
 		exit(1);
 	}
 
-	cpu->load[0] = cpu_r;
-	cpu->load[1] = v;
+	cpu->next_load[0] = cpu_r;
+	cpu->next_load[1] = v;
 }
 
-void op_lwc0(Cpu* cpu, Instruction instr) {
+void op_lwc0(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_swc0(Cpu* cpu, Instruction instr) {
+void op_swc0(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_lwc1(Cpu* cpu, Instruction instr) {
+void op_lwc1(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_swc1(Cpu* cpu, Instruction instr) {
+void op_swc1(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_lwc2(Cpu* cpu, Instruction instr) {
-	printf("uhandled lwc2\n");
-	exit(1);
+void op_lwc2(Cpu* cpu, Decoded* instr) {
+	if (cop2_enabled(cpu) == 0) {
+		return exception(cpu, COPROCESSOR_ERROR);
+	}
+
+	uint32_t addr = get_reg(cpu, instr->s) + instr->imm_se;
+
+	if (addr % 4 != 0) {
+		return exception(cpu, LOAD_BUS);
+	}
+
+	gte_write_data(&cpu->gte, instr->t, cpu_load32(cpu, addr));
 }
 
-void op_swc2(Cpu* cpu, Instruction instr) {
-	printf("unhandled swc2\n");
-	exit(1);
+void op_swc2(Cpu* cpu, Decoded* instr) {
+	if (cop2_enabled(cpu) == 0) {
+		return exception(cpu, COPROCESSOR_ERROR);
+	}
+
+	uint32_t addr = get_reg(cpu, instr->s) + instr->imm_se;
+
+	if (addr % 4 != 0) {
+		return exception(cpu, STORE_BUS);
+	}
+
+	cpu_store32(cpu, addr, gte_read_data(&cpu->gte, instr->t));
 }
 
-void op_lwc3(Cpu* cpu, Instruction instr) {
+void op_lwc3(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
 
-void op_swc3(Cpu* cpu, Instruction instr) {
+void op_swc3(Cpu* cpu, Decoded* instr) {
 	exception(cpu, COPROCESSOR_ERROR);
 }
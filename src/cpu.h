@@ -7,11 +7,43 @@
 #include "platform.h"
 #include "interconnect.h"
 #include "instruction.h"
+#include "block.h"
+#include "dispatch.h"
+#include "idle.h"
+#include "breakpoint.h"
+#include "gte.h"
+#include "timing.h"
+#include "icache.h"
+#include "hle.h"
+#include "exe.h"
+#include "profile.h"
+#include "trace/trace.h"
 
 #define RESET 0xbfc00000
 #define GARBAGE_VALUE 0xdeadbeef
+// fetch_tag of an empty fetch cache, pc >> MEM_PAGE_SHIFT never gets there
+#define FETCH_NONE 0xffffffff
+#define DECODED_PAGE_OPS ((1 << MEM_PAGE_SHIFT) / 4)
 
-typedef struct {
+typedef enum {
+    CPU_MODE_INTERPRETER,
+    CPU_MODE_CACHED,
+    CPU_MODE_JIT,
+    CPU_MODE_PROFILE,
+    CPU_MODE_TRACE,
+    CPU_MODE_DEBUG, // swapped in while breakpoints are armed
+} CpuMode;
+
+// why cpu_run_for returned
+typedef enum {
+    CPU_EXIT_BUDGET,
+    CPU_EXIT_EVENT, // a scheduler event is due
+    CPU_EXIT_BREAK, // the guest executed break
+} CpuExit;
+
+typedef struct Jit Jit;
+
+typedef struct Cpu {
     uint32_t pc;    
     uint32_t sr;
     uint32_t next_pc;
@@ -29,8 +61,41 @@ typedef struct {
     Interconnect* intr;
     uint32_t regs[32];
 
-    uint32_t out[32];
-    uint32_t load[2]; // addr, value
+    uint32_t load[2]; // pending load retired after this instruction: reg, value
+    uint32_t next_load[2]; // load issued by this instruction: reg, value
+
+    uint64_t cycles;
+    uint64_t deadline; // the run loops return once cycles reaches it
+    uint64_t resume; // deadline to put back after cpu_yield, 0 if none
+    uint64_t muldiv_ready; // cycle at which hi/lo hold the last mult/div result
+    uint8_t* regions; // MemRegion of every 4 kB page, for access costs
+    CpuExit exit;
+
+    IdleLoop idle;
+    Gte gte;
+    Breakpoints breakpoints;
+    ICache icache;
+
+    // host memory of the page instructions are currently fetched from
+    uint32_t fetch_tag; // pc >> MEM_PAGE_SHIFT
+    uint8_t* fetch_page;
+    Decoded* fetch_decoded; // cpu->decoded of the same page
+    Decoded fetch_uncached; // for instructions fetched through the slow path
+    uint64_t fetch_hits;
+    uint64_t fetch_misses;
+    uint64_t block_ops; // instructions run by the block engines, the interpreter counts fetches
+
+    CpuMode mode;
+    CpuDispatch dispatch;
+    BlockCache* cache;
+    Jit* jit;
+    Hle* hle; // NULL unless kernel calls are run natively
+    Exe* exe; // loaded once the BIOS reaches the shell
+    Profile* profile;
+    Trace* trace;
+
+    // predecoded instructions per 64 kB page of the masked physical space
+    Decoded* decoded[MEM_PAGE_COUNT];
 } Cpu;
 
 typedef enum {
@@ -50,99 +115,112 @@ char check_underflow(Cpu* cpu, uint32_t);
 
 uint32_t get_reg(Cpu* cpu, uint32_t index);
 void set_reg(Cpu* cpu, uint32_t index, uint32_t v);
-void decode_and_execute(Cpu* cpu, Instruction instr);
+void decode_and_execute(Cpu* cpu, Decoded* instr);
+extern const OpHandler HANDLERS[128];
+OpHandler op_handler(Instruction instr);
 uint32_t cpu_load32(Cpu* cpu, uint32_t addr);
 uint32_t cpu_load16(Cpu* cpu, uint32_t addr);
 uint8_t cpu_load8(Cpu* cpu, uint32_t addr);
 void cpu_store32(Cpu* cpu, uint32_t addr, uint32_t v);
 void cpu_store16(Cpu* cpu, uint32_t addr, uint16_t v);
 void cpu_store8(Cpu* cpu, uint32_t addr, uint8_t v);
+CpuExit cpu_run_for(Cpu* cpu, uint64_t cycles);
+void cpu_stop(Cpu* cpu, CpuExit reason);
+void cpu_yield(Cpu* cpu);
+void cpu_decode(Cpu* cpu, Decoded* op, Instruction word, uint32_t pc);
+Decoded* cpu_fetch(Cpu* cpu);
+char cpu_fetch_hooked(Cpu* cpu);
+uint32_t cpu_peek32(Cpu* cpu, uint32_t addr);
 void run_next_instruction(Cpu* cpu);
+void retire_load(Cpu* cpu);
 void exception(Cpu* cpu, Exception cause);
-
-void op_secondary(Cpu* cpu, Instruction instr);
-void op_bcondz(Cpu* cpu, Instruction instr);
-
-void op_lui(Cpu* cpu, Instruction instr);
-void op_ori(Cpu* cpu, Instruction instr);
-void op_sw(Cpu* cpu, Instruction instr);
-void op_addiu(Cpu* cpu, Instruction instr);
-void op_j(Cpu* cpu, Instruction instr);
-void branch(Cpu*, uint32_t offset);
-void op_bne(Cpu* cpu, Instruction instr);
-void op_addi(Cpu* cpu, Instruction instr);
-void op_lw(Cpu* cpu, Instruction instr);
-void op_sh(Cpu* cpu, Instruction instr);
-void op_jal(Cpu* cpu, Instruction instr);
-void op_andi(Cpu* cpu, Instruction instr);
-void op_sb(Cpu* cpu, Instruction instr);
-void op_jr(Cpu* cpu, Instruction instr);
-void op_lb(Cpu* cpu, Instruction instr);
-void op_beq(Cpu* cpu, Instruction instr);
-void op_bgtz(Cpu* cpu, Instruction instr);
-void op_blez(Cpu* cpu, Instruction instr);
-void op_lbu(Cpu* cpu, Instruction instr);
-void op_bltz(Cpu* cpu, Instruction instr);
-void op_bgez(Cpu* cpu, Instruction instr);
-void op_bltzal(Cpu* cpu, Instruction instr);
-void op_bgezal(Cpu* cpu, Instruction instr);
-void op_slti(Cpu* cpu, Instruction instr);
-void op_sltiu(Cpu* cpu, Instruction instr);
-void op_lhu(Cpu* cpu, Instruction instr);
-void op_xori(Cpu* cpu, Instruction instr);
-void op_lwl(Cpu* cpu, Instruction instr);
-void op_lwr(Cpu* cpu, Instruction instr);
-void op_swl(Cpu* cpu, Instruction instr);
-void op_swr(Cpu* cpu, Instruction instr);
-void op_illegal(Cpu* cpu, Instruction instr);
-
-void op_sll(Cpu* cpu, Instruction instr);
-void op_or(Cpu* cpu, Instruction instr);
-void op_sltu(Cpu* cpu, Instruction instr);
-void op_addu(Cpu* cpu, Instruction instr);
-void op_and(Cpu* cpu, Instruction instr);
-void op_add(Cpu* cpu, Instruction instr);
-void op_jalr(Cpu* cpu, Instruction instr);
-void op_subu(Cpu* cpu, Instruction instr);
-void op_sra(Cpu* cpu, Instruction instr);
-void op_div(Cpu* cpu, Instruction instr);
-void op_mflo(Cpu* cpu, Instruction instr);
-void op_srl(Cpu* cpu, Instruction instr);
-void op_divu(Cpu* cpu, Instruction instr);
-void op_mfhi(Cpu* cpu, Instruction instr);
-void op_slt(Cpu* cpu, Instruction instr);
-void op_syscall(Cpu* cpu, Instruction instr);
-void op_mtlo(Cpu* cpu, Instruction instr);
-void op_mthi(Cpu* cpu, Instruction instr);
-void op_rfe(Cpu* cpu, Instruction instr);
-void op_sllv(Cpu* cpu, Instruction instr);
-void op_lh(Cpu* cpu, Instruction instr);
-void op_nor(Cpu* cpu, Instruction instr);
-void op_srav(Cpu* cpu, Instruction instr);
-void op_srlv(Cpu* cpu, Instruction instr);
-void op_multu(Cpu* cpu, Instruction instr);
-void op_xor(Cpu* cpu, Instruction instr);
-void op_break(Cpu* cpu, Instruction instr);
-void op_mult(Cpu* cpu, Instruction instr);
-void op_sub(Cpu* cpu, Instruction instr);
-
-void op_cop0(Cpu* cpu, Instruction instr);
-void op_cop1(Cpu* cpu, Instruction instr);
-void op_cop2(Cpu* cpu, Instruction instr);
-void op_cop3(Cpu* cpu, Instruction instr);
-
-void op_mtc0(Cpu* cpu, Instruction instr);
-void op_mfc0(Cpu* cpu, Instruction instr);
-void op_lwc0(Cpu* cpu, Instruction instr);
-void op_swc0(Cpu* cpu, Instruction instr);
-
-void op_lwc1(Cpu* cpu, Instruction instr);
-void op_swc1(Cpu* cpu, Instruction instr);
-
-void op_lwc2(Cpu* cpu, Instruction instr);
-void op_swc2(Cpu* cpu, Instruction instr);
-
-void op_lwc3(Cpu* cpu, Instruction instr);
-void op_swc3(Cpu* cpu, Instruction instr);
+void exception_vector(Cpu* cpu, Exception cause, uint32_t handler);
+void muldiv_wait(Cpu* cpu);
+void cpu_icache_fetch(Cpu* cpu, Decoded* instr);
+
+void op_secondary(Cpu* cpu, Decoded* instr);
+void op_bcondz(Cpu* cpu, Decoded* instr);
+
+void op_lui(Cpu* cpu, Decoded* instr);
+void op_ori(Cpu* cpu, Decoded* instr);
+void op_sw(Cpu* cpu, Decoded* instr);
+void op_addiu(Cpu* cpu, Decoded* instr);
+void op_j(Cpu* cpu, Decoded* instr);
+void branch(Cpu*, uint32_t target);
+void op_bne(Cpu* cpu, Decoded* instr);
+void op_addi(Cpu* cpu, Decoded* instr);
+void op_lw(Cpu* cpu, Decoded* instr);
+void op_sh(Cpu* cpu, Decoded* instr);
+void op_jal(Cpu* cpu, Decoded* instr);
+void op_andi(Cpu* cpu, Decoded* instr);
+void op_sb(Cpu* cpu, Decoded* instr);
+void op_jr(Cpu* cpu, Decoded* instr);
+void op_lb(Cpu* cpu, Decoded* instr);
+void op_beq(Cpu* cpu, Decoded* instr);
+void op_bgtz(Cpu* cpu, Decoded* instr);
+void op_blez(Cpu* cpu, Decoded* instr);
+void op_lbu(Cpu* cpu, Decoded* instr);
+void op_bltz(Cpu* cpu, Decoded* instr);
+void op_bgez(Cpu* cpu, Decoded* instr);
+void op_bltzal(Cpu* cpu, Decoded* instr);
+void op_bgezal(Cpu* cpu, Decoded* instr);
+void op_slti(Cpu* cpu, Decoded* instr);
+void op_sltiu(Cpu* cpu, Decoded* instr);
+void op_lhu(Cpu* cpu, Decoded* instr);
+void op_xori(Cpu* cpu, Decoded* instr);
+void op_lwl(Cpu* cpu, Decoded* instr);
+void op_lwr(Cpu* cpu, Decoded* instr);
+void op_swl(Cpu* cpu, Decoded* instr);
+void op_swr(Cpu* cpu, Decoded* instr);
+void op_illegal(Cpu* cpu, Decoded* instr);
+
+void op_sll(Cpu* cpu, Decoded* instr);
+void op_or(Cpu* cpu, Decoded* instr);
+void op_sltu(Cpu* cpu, Decoded* instr);
+void op_addu(Cpu* cpu, Decoded* instr);
+void op_and(Cpu* cpu, Decoded* instr);
+void op_add(Cpu* cpu, Decoded* instr);
+void op_jalr(Cpu* cpu, Decoded* instr);
+void op_subu(Cpu* cpu, Decoded* instr);
+void op_sra(Cpu* cpu, Decoded* instr);
+void op_div(Cpu* cpu, Decoded* instr);
+void op_mflo(Cpu* cpu, Decoded* instr);
+void op_srl(Cpu* cpu, Decoded* instr);
+void op_divu(Cpu* cpu, Decoded* instr);
+void op_mfhi(Cpu* cpu, Decoded* instr);
+void op_slt(Cpu* cpu, Decoded* instr);
+void op_syscall(Cpu* cpu, Decoded* instr);
+void op_mtlo(Cpu* cpu, Decoded* instr);
+void op_mthi(Cpu* cpu, Decoded* instr);
+void op_rfe(Cpu* cpu, Decoded* instr);
+void op_sllv(Cpu* cpu, Decoded* instr);
+void op_lh(Cpu* cpu, Decoded* instr);
+void op_nor(Cpu* cpu, Decoded* instr);
+void op_srav(Cpu* cpu, Decoded* instr);
+void op_srlv(Cpu* cpu, Decoded* instr);
+void op_multu(Cpu* cpu, Decoded* instr);
+void op_xor(Cpu* cpu, Decoded* instr);
+void op_break(Cpu* cpu, Decoded* instr);
+void op_mult(Cpu* cpu, Decoded* instr);
+void op_sub(Cpu* cpu, Decoded* instr);
+
+void op_cop0(Cpu* cpu, Decoded* instr);
+void op_cop1(Cpu* cpu, Decoded* instr);
+void op_cop2(Cpu* cpu, Decoded* instr);
+void op_cop3(Cpu* cpu, Decoded* instr);
+
+void op_mtc0(Cpu* cpu, Decoded* instr);
+void op_mfc0(Cpu* cpu, Decoded* instr);
+void op_lwc0(Cpu* cpu, Decoded* instr);
+void op_swc0(Cpu* cpu, Decoded* instr);
+
+void op_lwc1(Cpu* cpu, Decoded* instr);
+void op_swc1(Cpu* cpu, Decoded* instr);
+
+void op_lwc2(Cpu* cpu, Decoded* instr);
+void op_swc2(Cpu* cpu, Decoded* instr);
+
+void op_lwc3(Cpu* cpu, Decoded* instr);
+void op_swc3(Cpu* cpu, Decoded* instr);
 
 #endif
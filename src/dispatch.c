@@ -0,0 +1,142 @@
+#include "dispatch.h"
+
+#include "cpu.h"
+
+const char* DISPATCH_NAMES[3] = { "switch", "table", "threaded" };
+
+CpuDispatch dispatch_from_name(const char* name) {
+	for (int i = 0; i < 3; ++i) {
+		if (strcmp(name, DISPATCH_NAMES[i]) == 0) {
+			return i;
+		}
+	}
+
+	printf("unknown dispatcher: %s\n", name);
+	exit(1);
+}
+
+// runs until cpu->cycles reaches cpu->deadline
+void run_instructions(Cpu* cpu) {
+	switch (cpu->dispatch) {
+	case DISPATCH_SWITCH:
+		return run_switch(cpu);
+	case DISPATCH_TABLE:
+		return run_table(cpu);
+	case DISPATCH_THREADED:
+		return run_threaded(cpu);
+	}
+}
+
+void run_switch(Cpu* cpu) {
+	while (cpu->cycles < cpu->deadline) {
+		run_next_instruction(cpu);
+	}
+}
+
+// same steps as run_next_instruction
+void run_table(Cpu* cpu) {
+	while (cpu->cycles < cpu->deadline) {
+		cpu->curr_pc = cpu->pc;
+
+		if (cpu->curr_pc % 4 != 0) {
+			exception(cpu, LOAD_BUS);
+			continue;
+		}
+
+		Decoded* instr = cpu_fetch(cpu);
+
+		cpu->cycles += instr->cycles;
+
+		cpu->pc = cpu->next_pc;
+		cpu->next_pc += 4;
+
+		cpu->delay_slot = cpu->branch;
+		cpu->branch = 0;
+
+		HANDLERS[instr->id](cpu, instr);
+
+		retire_load(cpu);
+	}
+}
+
+#ifdef __GNUC__
+
+#define THREADED_OPS(X) \
+	X(op_bcondz) X(op_j) X(op_jal) X(op_beq) X(op_bne) X(op_blez) X(op_bgtz) \
+	X(op_addi) X(op_addiu) X(op_slti) X(op_sltiu) X(op_andi) X(op_ori) X(op_xori) \
+	X(op_lui) X(op_cop0) X(op_cop1) X(op_cop2) X(op_cop3) X(op_illegal) \
+	X(op_lb) X(op_lh) X(op_lwl) X(op_lw) X(op_lbu) X(op_lhu) X(op_lwr) \
+	X(op_sb) X(op_sh) X(op_swl) X(op_sw) X(op_swr) \
+	X(op_lwc0) X(op_lwc1) X(op_lwc2) X(op_lwc3) X(op_swc0) X(op_swc1) X(op_swc2) X(op_swc3) \
+	X(op_sll) X(op_srl) X(op_sra) X(op_sllv) X(op_srlv) X(op_srav) X(op_jr) X(op_jalr) \
+	X(op_syscall) X(op_break) X(op_mfhi) X(op_mthi) X(op_mflo) X(op_mtlo) \
+	X(op_mult) X(op_multu) X(op_div) X(op_divu) X(op_add) X(op_addu) X(op_sub) X(op_subu) \
+	X(op_and) X(op_or) X(op_xor) X(op_nor) X(op_slt) X(op_sltu)
+
+// fetch the next instruction and jump straight to its handler, every handler
+// gets its own copy so the indirect branches are predicted per handler
+#define THREADED_DISPATCH() \
+	do { \
+		if (cpu->cycles >= cpu->deadline) { \
+			return; \
+		} \
+		cpu->curr_pc = cpu->pc; \
+		if (cpu->curr_pc % 4 != 0) { \
+			goto misaligned; \
+		} \
+		instr = cpu_fetch(cpu); \
+		cpu->cycles += instr->cycles; \
+		cpu->pc = cpu->next_pc; \
+		cpu->next_pc += 4; \
+		cpu->delay_slot = cpu->branch; \
+		cpu->branch = 0; \
+		goto *labels[instr->id]; \
+	} while (0)
+
+#define THREADED_ENTRY(op) { op, &&label_##op },
+
+#define THREADED_LABEL(op) \
+	label_##op: \
+		op(cpu, instr); \
+		retire_load(cpu); \
+		THREADED_DISPATCH();
+
+void run_threaded(Cpu* cpu) {
+	static void* labels[128];
+	static char labels_ready = 0;
+
+	// labels only exist inside this function, map HANDLERS onto them once
+	if (labels_ready == 0) {
+		struct { OpHandler handler; void* label; } ops[] = { THREADED_OPS(THREADED_ENTRY) };
+
+		for (int i = 0; i < 128; ++i) {
+			labels[i] = &&label_op_illegal;
+
+			for (int j = 0; j < sizeof(ops) / sizeof(ops[0]); ++j) {
+				if (ops[j].handler == HANDLERS[i]) {
+					labels[i] = ops[j].label;
+				}
+			}
+		}
+
+		labels_ready = 1;
+	}
+
+	Decoded* instr;
+
+	THREADED_DISPATCH();
+
+misaligned:
+	exception(cpu, LOAD_BUS);
+	THREADED_DISPATCH();
+
+	THREADED_OPS(THREADED_LABEL)
+}
+
+#else
+
+void run_threaded(Cpu* cpu) {
+	run_table(cpu);
+}
+
+#endif
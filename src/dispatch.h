@@ -0,0 +1,24 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdint.h>
+
+#include "instruction.h"
+
+typedef struct Cpu Cpu;
+
+typedef enum {
+    DISPATCH_SWITCH, // decode_and_execute
+    DISPATCH_TABLE, // one indirect call through HANDLERS
+    DISPATCH_THREADED, // computed goto, falls back to DISPATCH_TABLE
+} CpuDispatch;
+
+extern const char* DISPATCH_NAMES[3];
+
+CpuDispatch dispatch_from_name(const char* name);
+void run_instructions(Cpu* cpu);
+void run_switch(Cpu* cpu);
+void run_table(Cpu* cpu);
+void run_threaded(Cpu* cpu);
+
+#endif
@@ -1,13 +1,15 @@
 #include "dma.h"
 
 #include "interconnect.h"
+#include "block.h"
 
 Dma* initialize_dma() {
 	Dma* dma = malloc(sizeof(Dma));
 	dma->control = DMA_RESET;
+	dma->interrupt = 0;
 
 	for(int i = 0; i < 7; ++i) {
-		Channel* ch = malloc(sizeof(Channel));
+		Channel* ch = calloc(1, sizeof(Channel));
 		dma->channels[i] = ch;
 	}
     
@@ -205,6 +207,10 @@ void dma_block(Dma* dma, DmaChannel dch, Interconnect* intr) {
 			}
 		
 			ram_store32(intr->ram, cur_addr, word);
+
+			if (intr->cache != NULL) {
+				block_cache_invalidate(intr->cache, cur_addr);
+			}
 		}
 			break;
 		default:
@@ -0,0 +1,127 @@
+#include "exe.h"
+
+#include <stdio.h>
+
+#include "cpu.h"
+
+uint32_t exe_header32(uint8_t* header, uint32_t offset) {
+	uint32_t v;
+	memcpy(&v, header + offset, 4);
+	return v;
+}
+
+Exe* initialize_exe(const char* path) {
+	FILE* fptr = fopen(path, "rb");
+
+	if (fptr == NULL) {
+		printf("can't open exe: %s\n", path);
+		exit(1);
+	}
+
+	uint8_t header[EXE_HEADER_SIZE];
+
+	if (fread(header, EXE_HEADER_SIZE, 1, fptr) != 1 || memcmp(header, "PS-X EXE", 8) != 0) {
+		printf("not a PS-X EXE: %s\n", path);
+		exit(1);
+	}
+
+	Exe* exe = malloc(sizeof(Exe));
+
+	exe->pc = exe_header32(header, 0x10);
+	exe->gp = exe_header32(header, 0x14);
+	exe->text_addr = exe_header32(header, 0x18);
+	exe->text_size = exe_header32(header, 0x1c);
+	exe->bss_addr = exe_header32(header, 0x28);
+	exe->bss_size = exe_header32(header, 0x2c);
+	exe->stack_addr = exe_header32(header, 0x30);
+	exe->stack_size = exe_header32(header, 0x34);
+
+	uint32_t text = mask_region(exe->text_addr);
+	uint32_t bss = mask_region(exe->bss_addr);
+
+	if (text >= RAM_SIZE || exe->text_size > RAM_SIZE - text
+	    || (exe->bss_size > 0 && (bss >= RAM_SIZE || exe->bss_size > RAM_SIZE - bss))) {
+		printf("exe doesn't fit in RAM: %s\n", path);
+		exit(1);
+	}
+
+	exe->text = malloc(exe->text_size);
+
+	if (fread(exe->text, 1, exe->text_size, fptr) != exe->text_size) {
+		printf("truncated exe: %s\n", path);
+		exit(1);
+	}
+
+	fclose(fptr);
+
+	return exe;
+}
+
+// drop whatever the block cache compiled from the RAM the exe lands in
+void exe_invalidate(Cpu* cpu, uint32_t addr, uint32_t size) {
+	if (cpu->cache == NULL) {
+		return;
+	}
+
+	block_cache_invalidate_range(cpu->cache, addr, size);
+}
+
+// Copies the exe into RAM and sets up the registers the way the BIOS shell
+// does before jumping to it. Execution continues at the exe entry point
+// after the current instruction. The exe is freed.
+void exe_boot(Cpu* cpu) {
+	Exe* exe = cpu->exe;
+	Ram* ram = cpu->intr->ram;
+	uint32_t text = mask_region(exe->text_addr);
+	uint32_t bss = mask_region(exe->bss_addr);
+
+	memcpy(ram->data + text, exe->text, exe->text_size);
+	exe_invalidate(cpu, text, exe->text_size);
+
+	if (exe->bss_size > 0) {
+		memset(ram->data + bss, 0, exe->bss_size);
+		exe_invalidate(cpu, bss, exe->bss_size);
+	}
+
+	cpu->regs[28] = exe->gp;
+
+	if (exe->stack_addr != 0) {
+		cpu->regs[29] = exe->stack_addr + exe->stack_size;
+		cpu->regs[30] = cpu->regs[29];
+	}
+
+	cpu->fetch_tag = FETCH_NONE;
+	cpu->next_pc = exe->pc;
+
+	free(exe->text);
+	free(exe);
+	cpu->exe = NULL;
+}
+
+// boots straight into the exe without running any of the BIOS
+void exe_fast_boot(Cpu* cpu) {
+	uint32_t stack = cpu->exe->stack_addr;
+
+	exe_boot(cpu);
+
+	// no shell ran to leave a stack behind, use the one it would have
+	if (stack == 0) {
+		cpu->regs[29] = EXE_DEFAULT_STACK;
+		cpu->regs[30] = EXE_DEFAULT_STACK;
+	}
+
+	cpu->pc = cpu->next_pc;
+	cpu->next_pc = cpu->pc + 4;
+}
+
+// Called from the fetch slow path while an exe is waiting for the kernel.
+// Returns 1 once the shell entry point is reached and the exe is loaded.
+char exe_hook(Cpu* cpu, uint32_t phys) {
+	if (phys != mask_region(EXE_SHELL_ENTRY)) {
+		return 0;
+	}
+
+	exe_boot(cpu);
+
+	return 1;
+}
@@ -0,0 +1,32 @@
+#ifndef EXE_H
+#define EXE_H
+
+#include <stdint.h>
+
+#define EXE_HEADER_SIZE 0x800
+// the BIOS jumps here once the kernel is set up
+#define EXE_SHELL_ENTRY 0x80030000
+// sp the shell hands over when the header asks for no stack
+#define EXE_DEFAULT_STACK 0x801ffff0
+
+typedef struct Cpu Cpu;
+
+typedef struct Exe {
+    uint32_t pc;
+    uint32_t gp;
+    uint32_t text_addr;
+    uint32_t text_size;
+    uint32_t bss_addr;
+    uint32_t bss_size;
+    uint32_t stack_addr;
+    uint32_t stack_size;
+
+    uint8_t* text;
+} Exe;
+
+Exe* initialize_exe(const char* path);
+void exe_boot(Cpu* cpu);
+void exe_fast_boot(Cpu* cpu);
+char exe_hook(Cpu* cpu, uint32_t phys);
+
+#endif
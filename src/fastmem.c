@@ -0,0 +1,119 @@
+#include "fastmem.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// glibc only names it with _GNU_SOURCE
+#ifndef REG_RIP
+#define REG_RIP 16
+#endif
+#endif
+
+const uint32_t FASTMEM_SEGMENTS[3] = { 0x00000000, 0x80000000, 0xa0000000 };
+
+uint8_t* fastmem_base = NULL;
+
+#if defined(__linux__) && defined(__x86_64__)
+
+// A fault inside the window from a jit access patches its site into a jmp to
+// the slow path and resumes there. Anything else is a real crash.
+void fastmem_fault(int sig, siginfo_t* info, void* context) {
+	ucontext_t* uc = context;
+	uint8_t* addr = info->si_addr;
+	uint8_t* access = (uint8_t*)uc->uc_mcontext.gregs[REG_RIP];
+	uint8_t* site = access - FASTMEM_SITE_SIZE;
+
+	// nop [rax + disp32]
+	if (addr >= fastmem_base && addr < fastmem_base + FASTMEM_WINDOW_SIZE
+	    && site[0] == 0x0f && site[1] == 0x1f && site[2] == 0x80) {
+		int32_t slow;
+		memcpy(&slow, site + 3, 4);
+
+		// jmp rel32, from the end of the 5 byte jmp instead of the nop
+		int32_t rel = slow + FASTMEM_SITE_SIZE - 5;
+		site[0] = 0xe9;
+		memcpy(site + 1, &rel, 4);
+
+		uc->uc_mcontext.gregs[REG_RIP] = (uintptr_t)(access + slow);
+		return;
+	}
+
+	signal(sig, SIG_DFL);
+}
+
+int fastmem_memfd(const char* name, uint8_t* data, uint32_t size) {
+	int fd = syscall(SYS_memfd_create, name, 0);
+
+	if (fd < 0 || ftruncate(fd, size) != 0) {
+		printf("failed to create %s memfd\n", name);
+		exit(1);
+	}
+
+	if (pwrite(fd, data, size, 0) != size) {
+		printf("failed to fill %s memfd\n", name);
+		exit(1);
+	}
+
+	return fd;
+}
+
+void fastmem_map(uint8_t* at, uint32_t size, int prot, int fd) {
+	if (mmap(at, size, prot, MAP_SHARED | MAP_FIXED, fd, 0) != at) {
+		printf("failed to map fastmem view at %p\n", at);
+		exit(1);
+	}
+}
+
+void initialize_fastmem(Interconnect* intr) {
+	uint8_t* base = mmap(NULL, FASTMEM_WINDOW_SIZE, PROT_NONE,
+			     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (base == MAP_FAILED) {
+		printf("failed to reserve fastmem window\n");
+		exit(1);
+	}
+
+	int ram_fd = fastmem_memfd("ram", intr->ram->data, RAM_SIZE);
+	int bios_fd = fastmem_memfd("bios", intr->bios->data, BIOS_SIZE);
+
+	for (int i = 0; i < 3; ++i) {
+		uint8_t* segment = base + FASTMEM_SEGMENTS[i];
+
+		for (int m = 0; m < FASTMEM_RAM_MIRRORS; ++m) {
+			fastmem_map(segment + m * RAM_SIZE, RAM_SIZE, PROT_READ | PROT_WRITE, ram_fd);
+		}
+
+		fastmem_map(segment + BIOS_RANGE[0], BIOS_SIZE, PROT_READ, bios_fd);
+	}
+
+	close(ram_fd);
+	close(bios_fd);
+
+	// DMA and the page table keep working on the same memory through the
+	// first view
+	free(intr->ram->data);
+	intr->ram->data = base;
+	intr_map_pages(intr);
+
+	struct sigaction sa;
+	sa.sa_sigaction = fastmem_fault;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGSEGV, &sa, NULL);
+
+	fastmem_base = base;
+	intr->fastmem = base;
+}
+
+#else
+
+void initialize_fastmem(Interconnect* intr) {
+	printf("fastmem is only available on x86-64 linux hosts\n");
+	exit(1);
+}
+
+#endif
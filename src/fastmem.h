@@ -0,0 +1,23 @@
+#ifndef FASTMEM_H
+#define FASTMEM_H
+
+#include <stdint.h>
+
+#include "interconnect.h"
+
+// every guest address a is backed by host address base + a, so KUSEG, KSEG0
+// and KSEG1 each get their own view of RAM (repeated 4 times) and BIOS
+#define FASTMEM_WINDOW_SIZE ((uint64_t)1 << 32)
+#define FASTMEM_RAM_MIRRORS 4
+
+// Only the jit goes through the window. Each of its accesses is a single
+// host instruction at base + addr with no check in front, right after a
+// nop [rax + disp32] whose displacement is the offset from the end of the
+// nop to the access's slow path. The first time an access faults (mmio, or
+// a store to BIOS) the SIGSEGV handler rewrites the nop into a jmp to the
+// slow path, so that site never faults again.
+#define FASTMEM_SITE_SIZE 7
+
+void initialize_fastmem(Interconnect* intr);
+
+#endif
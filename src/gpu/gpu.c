@@ -8,7 +8,7 @@
 Shader *color_shader;
 Shader *texture_blend_shader;
 
-Gpu* initialize_gpu() {
+Gpu* gpu_alloc(char headless) {
 	Gpu* gpu = malloc(sizeof(Gpu));
        
 	gpu->gp1 = 0x14000000;
@@ -17,6 +17,26 @@ Gpu* initialize_gpu() {
 	gpu->fifoc = 0;
 	gpu->fifolen = 0;
 	gpu->last_render = 0.0f;
+	gpu->frames = 0;
+	gpu->headless = headless;
+
+	return gpu;
+}
+
+// no window and no GL, VRAM lives in plain memory and nothing is drawn
+Gpu* initialize_headless_gpu() {
+	Gpu* gpu = gpu_alloc(1);
+
+	gpu->window = NULL;
+	gpu->ptr16 = calloc(1024 * 512, sizeof(uint16_t));
+	gpu->ptr8 = calloc(2048 * 512, sizeof(uint8_t));
+	gpu->ptr4 = calloc(4096 * 512, sizeof(uint8_t));
+
+	return gpu;
+}
+
+Gpu* initialize_gpu() {
+	Gpu* gpu = gpu_alloc(0);
     
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -138,10 +158,18 @@ Gpu* initialize_gpu() {
 }
 
 void gpu_destroy(Gpu* gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
 	glfwTerminate();
 }
 
 void gpu_upload_texture(Gpu *gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
   /* Upload 16bit texture. */
   glBindTexture(GL_TEXTURE_2D, gpu->texture16);
   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gpu->pbo16);
@@ -206,6 +234,10 @@ uint16 gpu_vdr(Gpu* gpu) {
 }
 
 void gpu_render_clear(Gpu* gpu) {	
+	if (gpu->headless == 1) {
+		return;
+	}
+
 	if (glfwGetTime() - gpu->last_render > fps) {		
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -213,6 +245,10 @@ void gpu_render_clear(Gpu* gpu) {
 }
 
 void gpu_render_swap(Gpu* gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
 	float now = glfwGetTime();
 	if (now - gpu->last_render > fps) {		
 
@@ -222,6 +258,19 @@ void gpu_render_swap(Gpu* gpu) {
 	}
 }
 
+// keeps the window responsive even when the guest draws nothing
+void gpu_vblank(Scheduler* s, void* data, uint64_t time) {
+	Gpu* gpu = data;
+
+	gpu->frames += 1;
+
+	if (gpu->headless == 0) {
+		glfwPollEvents();
+	}
+
+	scheduler_add(s, time + GPU_FRAME_CYCLES, gpu_vblank, gpu);
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 	glViewport(0, 0, width, height);
 }
@@ -687,6 +736,10 @@ void attr_texpage(Gpu* gpu, uint32 v, uint8* x, uint8* y, uint8* st, uint8* texm
 }
 
 void tex4popblend(Gpu* gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
   uint16 cx, cy;
 
 	uint8 tpx, tpy, tpst, tpmode, tpdis;
@@ -851,6 +904,10 @@ void tex4popblend(Gpu* gpu) {
 }
 
 void sh4pop(Gpu* gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
 	float
 		r1, g1, b1,
 		x1, y1,
@@ -946,6 +1003,10 @@ void sh4pop(Gpu* gpu) {
 }
 
 void sh3pop(Gpu* gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
 	float
 		r1, g1, b1,
 		x1, y1,
@@ -1021,6 +1082,10 @@ void sh3pop(Gpu* gpu) {
 }
 
 void mon4pop(Gpu* gpu) {
+	if (gpu->headless == 1) {
+		return;
+	}
+
 	float
 		r, g, b,
 
@@ -8,8 +8,11 @@
 #include <math.h>
 
 #include "../range.h"
+#include "../scheduler.h"
 
 #define VRAM_SIZE 2048 * 512
+// NTSC frame
+#define GPU_FRAME_CYCLES (CPU_CLOCK / 60)
 
 typedef enum {
 	VRAM_VRAM,
@@ -44,6 +47,8 @@ typedef struct {
 	GPU_Mode gpu_mode;
 
 	float last_render;
+	uint64_t frames;
+	char headless; // no window, drawing commands are dropped
   
   uint32 pbo4, pbo8, pbo16; 
         
@@ -60,6 +65,7 @@ const float fps = 1.0f / 60.0f;
 
 
 Gpu* initialize_gpu();
+Gpu* initialize_headless_gpu();
 void gpu_destroy(Gpu* gpu);
 void gpu_upload_texture(Gpu *gpu);
 
@@ -74,6 +80,7 @@ uint16 gpu_vdr(Gpu* gpu);
 
 void gpu_render_clear(Gpu* gpu);
 void gpu_render_swap(Gpu* gpu);
+void gpu_vblank(Scheduler* s, void* data, uint64_t time);
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
     
@@ -0,0 +1,730 @@
+#include "gte.h"
+
+#include <string.h>
+
+// reciprocals for the RTPS/RTPT division: max(0, (40000h / (i + 100h) + 1) / 2 - 101h)
+const uint8_t GTE_UNR[0x101] = {
+	0xff, 0xfd, 0xfb, 0xf9, 0xf7, 0xf5, 0xf3, 0xf1, 0xef, 0xee, 0xec, 0xea, 0xe8, 0xe6, 0xe4, 0xe3,
+	0xe1, 0xdf, 0xdd, 0xdc, 0xda, 0xd8, 0xd6, 0xd5, 0xd3, 0xd1, 0xd0, 0xce, 0xcd, 0xcb, 0xc9, 0xc8,
+	0xc6, 0xc5, 0xc3, 0xc1, 0xc0, 0xbe, 0xbd, 0xbb, 0xba, 0xb8, 0xb7, 0xb5, 0xb4, 0xb2, 0xb1, 0xb0,
+	0xae, 0xad, 0xab, 0xaa, 0xa9, 0xa7, 0xa6, 0xa4, 0xa3, 0xa2, 0xa0, 0x9f, 0x9e, 0x9c, 0x9b, 0x9a,
+	0x99, 0x97, 0x96, 0x95, 0x94, 0x92, 0x91, 0x90, 0x8f, 0x8d, 0x8c, 0x8b, 0x8a, 0x89, 0x87, 0x86,
+	0x85, 0x84, 0x83, 0x82, 0x81, 0x7f, 0x7e, 0x7d, 0x7c, 0x7b, 0x7a, 0x79, 0x78, 0x77, 0x75, 0x74,
+	0x73, 0x72, 0x71, 0x70, 0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x69, 0x68, 0x67, 0x66, 0x65, 0x64,
+	0x63, 0x62, 0x61, 0x60, 0x5f, 0x5e, 0x5d, 0x5d, 0x5c, 0x5b, 0x5a, 0x59, 0x58, 0x57, 0x56, 0x55,
+	0x54, 0x53, 0x53, 0x52, 0x51, 0x50, 0x4f, 0x4e, 0x4d, 0x4d, 0x4c, 0x4b, 0x4a, 0x49, 0x48, 0x48,
+	0x47, 0x46, 0x45, 0x44, 0x43, 0x43, 0x42, 0x41, 0x40, 0x3f, 0x3f, 0x3e, 0x3d, 0x3c, 0x3c, 0x3b,
+	0x3a, 0x39, 0x39, 0x38, 0x37, 0x36, 0x36, 0x35, 0x34, 0x33, 0x33, 0x32, 0x31, 0x31, 0x30, 0x2f,
+	0x2e, 0x2e, 0x2d, 0x2c, 0x2c, 0x2b, 0x2a, 0x2a, 0x29, 0x28, 0x28, 0x27, 0x26, 0x26, 0x25, 0x24,
+	0x24, 0x23, 0x22, 0x22, 0x21, 0x20, 0x20, 0x1f, 0x1e, 0x1e, 0x1d, 0x1d, 0x1c, 0x1b, 0x1b, 0x1a,
+	0x19, 0x19, 0x18, 0x18, 0x17, 0x16, 0x16, 0x15, 0x15, 0x14, 0x14, 0x13, 0x12, 0x12, 0x11, 0x11,
+	0x10, 0x0f, 0x0f, 0x0e, 0x0e, 0x0d, 0x0d, 0x0c, 0x0c, 0x0b, 0x0a, 0x0a, 0x09, 0x09, 0x08, 0x08,
+	0x07, 0x07, 0x06, 0x06, 0x05, 0x05, 0x04, 0x04, 0x03, 0x03, 0x02, 0x02, 0x01, 0x01, 0x00, 0x00,
+	0x00,
+};
+
+const int32_t GTE_NO_TRANSLATION[3] = { 0, 0, 0 };
+
+void gte_reset(Gte* gte) {
+	memset(gte, 0, sizeof(Gte));
+}
+
+// IRGB/ORGB: IR1-IR3 as a 15 bit color
+uint32_t gte_orgb(Gte* gte) {
+	uint32_t c = 0;
+
+	for (int i = 0; i < 3; ++i) {
+		int32_t v = gte->ir[i + 1] >> 7;
+
+		c |= (v < 0 ? 0 : v > 0x1f ? 0x1f : v) << (i * 5);
+	}
+
+	return c;
+}
+
+uint32_t gte_read_data(Gte* gte, uint32_t r) {
+	switch (r) {
+	case 0:
+	case 2:
+	case 4:
+		return (uint16_t)gte->v[r / 2][0] | (uint32_t)(uint16_t)gte->v[r / 2][1] << 16;
+	case 1:
+	case 3:
+	case 5:
+		return (int32_t)gte->v[r / 2][2];
+	case 6: {
+		uint32_t v;
+		memcpy(&v, gte->rgbc, 4);
+		return v;
+	}
+	case 7:
+		return gte->otz;
+	case 8:
+	case 9:
+	case 10:
+	case 11:
+		return (int32_t)gte->ir[r - 8];
+	case 12:
+	case 13:
+	case 14:
+		return (uint16_t)gte->sxy[r - 12][0] | (uint32_t)(uint16_t)gte->sxy[r - 12][1] << 16;
+	case 15:
+		return gte_read_data(gte, 14);
+	case 16:
+	case 17:
+	case 18:
+	case 19:
+		return gte->sz[r - 16];
+	case 20:
+	case 21:
+	case 22: {
+		uint32_t v;
+		memcpy(&v, gte->rgb[r - 20], 4);
+		return v;
+	}
+	case 23:
+		return gte->res1;
+	case 24:
+	case 25:
+	case 26:
+	case 27:
+		return gte->mac[r - 24];
+	case 28:
+	case 29:
+		return gte_orgb(gte);
+	case 30:
+		return gte->lzcs;
+	default:
+		return gte->lzcr;
+	}
+}
+
+void gte_write_data(Gte* gte, uint32_t r, uint32_t v) {
+	switch (r) {
+	case 0:
+	case 2:
+	case 4:
+		gte->v[r / 2][0] = v;
+		gte->v[r / 2][1] = v >> 16;
+		break;
+	case 1:
+	case 3:
+	case 5:
+		gte->v[r / 2][2] = v;
+		break;
+	case 6:
+		memcpy(gte->rgbc, &v, 4);
+		break;
+	case 7:
+		gte->otz = v;
+		break;
+	case 8:
+	case 9:
+	case 10:
+	case 11:
+		gte->ir[r - 8] = v;
+		break;
+	case 15:
+		// SXYP pushes onto the fifo
+		memmove(gte->sxy[0], gte->sxy[1], sizeof(gte->sxy[0]) * 2);
+		r = 14;
+		// fallthrough
+	case 12:
+	case 13:
+	case 14:
+		gte->sxy[r - 12][0] = v;
+		gte->sxy[r - 12][1] = v >> 16;
+		break;
+	case 16:
+	case 17:
+	case 18:
+	case 19:
+		gte->sz[r - 16] = v;
+		break;
+	case 20:
+	case 21:
+	case 22:
+		memcpy(gte->rgb[r - 20], &v, 4);
+		break;
+	case 23:
+		gte->res1 = v;
+		break;
+	case 24:
+	case 25:
+	case 26:
+	case 27:
+		gte->mac[r - 24] = v;
+		break;
+	case 28:
+		for (int i = 0; i < 3; ++i) {
+			gte->ir[i + 1] = ((v >> (i * 5)) & 0x1f) << 7;
+		}
+		break;
+	case 30: {
+		// LZCR counts the leading bits equal to the sign bit
+		uint32_t bits = (int32_t)v < 0 ? ~v : v;
+
+		gte->lzcs = v;
+		gte->lzcr = bits == 0 ? 32 : __builtin_clz(bits);
+		break;
+	}
+	default:
+		// ORGB and LZCR are read only
+		break;
+	}
+}
+
+uint32_t gte_read_control(Gte* gte, uint32_t r) {
+	if (r < 24) {
+		uint32_t i = r % 8;
+
+		if (i >= 5) {
+			return gte->t[r / 8][i - 5];
+		}
+
+		int16_t* m = &gte->m[r / 8][0][0];
+
+		if (i == 4) {
+			return (int32_t)m[8];
+		}
+
+		return (uint16_t)m[i * 2] | (uint32_t)(uint16_t)m[i * 2 + 1] << 16;
+	}
+
+	switch (r) {
+	case 24:
+		return gte->ofx;
+	case 25:
+		return gte->ofy;
+	case 26:
+		// H reads back sign extended even though it is unsigned
+		return (int32_t)(int16_t)gte->h;
+	case 27:
+		return (int32_t)gte->dqa;
+	case 28:
+		return gte->dqb;
+	case 29:
+		return (int32_t)gte->zsf3;
+	case 30:
+		return (int32_t)gte->zsf4;
+	default:
+		return gte->flag;
+	}
+}
+
+void gte_write_control(Gte* gte, uint32_t r, uint32_t v) {
+	if (r < 24) {
+		uint32_t i = r % 8;
+
+		if (i >= 5) {
+			gte->t[r / 8][i - 5] = v;
+			return;
+		}
+
+		int16_t* m = &gte->m[r / 8][0][0];
+
+		if (i == 4) {
+			m[8] = v;
+			return;
+		}
+
+		m[i * 2] = v;
+		m[i * 2 + 1] = v >> 16;
+		return;
+	}
+
+	switch (r) {
+	case 24:
+		gte->ofx = v;
+		break;
+	case 25:
+		gte->ofy = v;
+		break;
+	case 26:
+		gte->h = v;
+		break;
+	case 27:
+		gte->dqa = v;
+		break;
+	case 28:
+		gte->dqb = v;
+		break;
+	case 29:
+		gte->zsf3 = v;
+		break;
+	case 30:
+		gte->zsf4 = v;
+		break;
+	default:
+		gte->flag = v & 0x7ffff000;
+
+		if ((gte->flag & GTE_FLAG_ERROR_MASK) != 0) {
+			gte->flag |= 1 << 31;
+		}
+	}
+}
+
+// flags MAC1-MAC3 (i) overflowing 44 bits and wraps v to 44 bits. The
+// hardware checks after every addition, not just on the final sum.
+int64_t gte_check_mac(Gte* gte, int i, int64_t v) {
+	if (v > 0x7ffffffffffll) {
+		gte->flag |= 1 << (31 - i);
+	} else if (v < -0x80000000000ll) {
+		gte->flag |= 1 << (28 - i);
+	}
+
+	return (int64_t)((uint64_t)v << 20) >> 20;
+}
+
+int32_t gte_set_mac(Gte* gte, int i, int64_t v, int shift) {
+	gte_check_mac(gte, i, v);
+	gte->mac[i] = v >> shift;
+
+	return gte->mac[i];
+}
+
+void gte_set_ir(Gte* gte, int i, int32_t v, char lm) {
+	int32_t min = lm == 1 ? 0 : -0x8000;
+
+	if (v < min) {
+		v = min;
+		gte->flag |= 1 << (25 - i);
+	} else if (v > 0x7fff) {
+		v = 0x7fff;
+		gte->flag |= 1 << (25 - i);
+	}
+
+	gte->ir[i] = v;
+}
+
+void gte_set_mac_ir(Gte* gte, int i, int64_t v, int shift, char lm) {
+	gte_set_ir(gte, i, gte_set_mac(gte, i, v, shift), lm);
+}
+
+// MAC0 only flags 32 bit overflow
+void gte_check_mac0(Gte* gte, int64_t v) {
+	if (v > 0x7fffffffll) {
+		gte->flag |= 1 << 16;
+	} else if (v < -0x80000000ll) {
+		gte->flag |= 1 << 15;
+	}
+}
+
+void gte_set_mac0(Gte* gte, int64_t v) {
+	gte_check_mac0(gte, v);
+	gte->mac[0] = v;
+}
+
+void gte_set_ir0(Gte* gte, int32_t v) {
+	if (v < 0) {
+		v = 0;
+		gte->flag |= 1 << 12;
+	} else if (v > 0x1000) {
+		v = 0x1000;
+		gte->flag |= 1 << 12;
+	}
+
+	gte->ir[0] = v;
+}
+
+uint16_t gte_saturate_z(Gte* gte, int32_t v) {
+	if (v < 0) {
+		gte->flag |= 1 << 18;
+		return 0;
+	}
+
+	if (v > 0xffff) {
+		gte->flag |= 1 << 18;
+		return 0xffff;
+	}
+
+	return v;
+}
+
+void gte_push_sz(Gte* gte, int32_t v) {
+	gte->sz[0] = gte->sz[1];
+	gte->sz[1] = gte->sz[2];
+	gte->sz[2] = gte->sz[3];
+	gte->sz[3] = gte_saturate_z(gte, v);
+}
+
+int16_t gte_saturate_xy(Gte* gte, int32_t v, int bit) {
+	if (v < -0x400) {
+		gte->flag |= 1 << bit;
+		return -0x400;
+	}
+
+	if (v > 0x3ff) {
+		gte->flag |= 1 << bit;
+		return 0x3ff;
+	}
+
+	return v;
+}
+
+void gte_push_sxy(Gte* gte, int32_t x, int32_t y) {
+	memmove(gte->sxy[0], gte->sxy[1], sizeof(gte->sxy[0]) * 2);
+	gte->sxy[2][0] = gte_saturate_xy(gte, x, 14);
+	gte->sxy[2][1] = gte_saturate_xy(gte, y, 13);
+}
+
+uint8_t gte_saturate_color(Gte* gte, int i, int32_t v) {
+	if (v < 0) {
+		gte->flag |= 1 << (22 - i);
+		return 0;
+	}
+
+	if (v > 0xff) {
+		gte->flag |= 1 << (22 - i);
+		return 0xff;
+	}
+
+	return v;
+}
+
+// color fifo = [MAC1, MAC2, MAC3] SAR 4 with the code byte of RGBC
+void gte_push_color(Gte* gte) {
+	memmove(gte->rgb[0], gte->rgb[1], sizeof(gte->rgb[0]) * 2);
+
+	for (int i = 0; i < 3; ++i) {
+		gte->rgb[2][i] = gte_saturate_color(gte, i + 1, gte->mac[i + 1] >> 4);
+	}
+
+	gte->rgb[2][3] = gte->rgbc[3];
+}
+
+// unsigned newton-raphson division used for perspective, saturates at 1ffffh
+uint32_t gte_divide(Gte* gte, uint32_t n, uint32_t d) {
+	if (d * 2 <= n) {
+		gte->flag |= 1 << 17;
+		return 0x1ffff;
+	}
+
+	int shift = __builtin_clz(d) - 16;
+
+	n <<= shift;
+	d <<= shift;
+
+	int32_t u = 0x101 + GTE_UNR[((d & 0x7fff) + 0x40) >> 7];
+	int32_t e = ((int32_t)(d | 0x8000) * -u + 0x80) >> 8;
+	uint32_t recip = (u * (0x20000 + e) + 0x80) >> 8;
+	uint32_t q = ((uint64_t)n * recip + 0x8000) >> 16;
+
+	return q < 0x1ffff ? q : 0x1ffff;
+}
+
+// [MAC1, MAC2, MAC3] = (T * 1000h + M * V) SAR shift, IR = MAC
+void gte_mul_mat_vec(Gte* gte, int16_t m[3][3], const int32_t* t, int16_t x, int16_t y, int16_t z, int shift, char lm) {
+	for (int i = 0; i < 3; ++i) {
+		int64_t v = gte_check_mac(gte, i + 1, ((int64_t)t[i] << 12) + (int64_t)m[i][0] * x);
+
+		v = gte_check_mac(gte, i + 1, v + (int64_t)m[i][1] * y);
+		gte_set_mac_ir(gte, i + 1, v + (int64_t)m[i][2] * z, shift, lm);
+	}
+}
+
+// MVMVA with the far color vector: the translation only reaches the flags
+// and IR saturation, the result is M * V without the first column
+void gte_mul_mat_vec_fc(Gte* gte, int16_t m[3][3], int16_t x, int16_t y, int16_t z, int shift, char lm) {
+	for (int i = 0; i < 3; ++i) {
+		int64_t v = gte_check_mac(gte, i + 1, ((int64_t)gte->t[2][i] << 12) + (int64_t)m[i][0] * x);
+
+		gte_set_ir(gte, i + 1, v >> shift, 0);
+
+		v = gte_check_mac(gte, i + 1, (int64_t)m[i][1] * y);
+		gte_set_mac_ir(gte, i + 1, v + (int64_t)m[i][2] * z, shift, lm);
+	}
+}
+
+// perspective transformation of one vector, RTPT does three
+void gte_rtp(Gte* gte, int16_t* v, int shift, char lm, char last) {
+	int64_t z = 0;
+
+	for (int i = 0; i < 3; ++i) {
+		int64_t mac = gte_check_mac(gte, i + 1, ((int64_t)gte->t[0][i] << 12) + (int64_t)gte->m[0][i][0] * v[0]);
+
+		mac = gte_check_mac(gte, i + 1, mac + (int64_t)gte->m[0][i][1] * v[1]);
+		mac += (int64_t)gte->m[0][i][2] * v[2];
+
+		gte_set_mac(gte, i + 1, mac, shift);
+		z = mac;
+	}
+
+	gte_set_ir(gte, 1, gte->mac[1], lm);
+	gte_set_ir(gte, 2, gte->mac[2], lm);
+
+	// IR3 saturates on MAC3, but its flag is set from MAC3 SAR 12 even when
+	// sf is 0
+	int32_t z12 = z >> 12;
+	int32_t min = lm == 1 ? 0 : -0x8000;
+
+	if (z12 < -0x8000 || z12 > 0x7fff) {
+		gte->flag |= 1 << 22;
+	}
+
+	gte->ir[3] = gte->mac[3] < min ? min : gte->mac[3] > 0x7fff ? 0x7fff : gte->mac[3];
+
+	gte_push_sz(gte, z12);
+
+	int64_t q = gte_divide(gte, gte->h, gte->sz[3]);
+	int64_t sx = q * gte->ir[1] + gte->ofx;
+	int64_t sy = q * gte->ir[2] + gte->ofy;
+
+	gte_check_mac0(gte, sx);
+	gte_check_mac0(gte, sy);
+	gte_push_sxy(gte, sx >> 16, sy >> 16);
+
+	if (last == 1) {
+		int64_t depth = q * gte->dqa + gte->dqb;
+
+		gte_set_mac0(gte, depth);
+		gte_set_ir0(gte, depth >> 12);
+	}
+}
+
+// [MAC1, MAC2, MAC3] = in + (FC - in) * IR0
+void gte_interpolate(Gte* gte, int64_t* in, int shift, char lm) {
+	for (int i = 0; i < 3; ++i) {
+		gte_set_mac_ir(gte, i + 1, ((int64_t)gte->t[2][i] << 12) - in[i], shift, 0);
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		gte_set_mac_ir(gte, i + 1, (int64_t)gte->ir[i + 1] * gte->ir[0] + in[i], shift, lm);
+	}
+}
+
+// normal color: IR = LCM * (LLM * V) + BK
+void gte_nc(Gte* gte, int16_t* v, int shift, char lm) {
+	gte_mul_mat_vec(gte, gte->m[1], GTE_NO_TRANSLATION, v[0], v[1], v[2], shift, lm);
+	gte_mul_mat_vec(gte, gte->m[2], gte->t[1], gte->ir[1], gte->ir[2], gte->ir[3], shift, lm);
+}
+
+// [MAC1, MAC2, MAC3] = [R * IR1, G * IR2, B * IR3] SHL 4 SAR shift, used by NCCx and CC
+void gte_color(Gte* gte, int shift, char lm) {
+	for (int i = 0; i < 3; ++i) {
+		gte_set_mac(gte, i + 1, ((int64_t)gte->rgbc[i] * gte->ir[i + 1]) << 4, 0);
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		gte_set_mac_ir(gte, i + 1, gte->mac[i + 1], shift, lm);
+	}
+
+	gte_push_color(gte);
+}
+
+// [R * IR1, G * IR2, B * IR3] SHL 4 interpolated towards the far color, used
+// by NCDx, CDP and DCPL
+void gte_depth_cue(Gte* gte, int shift, char lm) {
+	int64_t in[3];
+
+	for (int i = 0; i < 3; ++i) {
+		in[i] = ((int64_t)gte->rgbc[i] * gte->ir[i + 1]) << 4;
+	}
+
+	gte_interpolate(gte, in, shift, lm);
+	gte_push_color(gte);
+}
+
+// DPCS uses RGBC, DPCT the front of the color fifo three times
+void gte_dpc(Gte* gte, uint8_t* color, int shift, char lm) {
+	int64_t in[3];
+
+	for (int i = 0; i < 3; ++i) {
+		in[i] = (int64_t)color[i] << 16;
+	}
+
+	gte_interpolate(gte, in, shift, lm);
+	gte_push_color(gte);
+}
+
+void gte_mvmva(Gte* gte, uint32_t cmd, int shift, char lm) {
+	int16_t garbage[3][3];
+	int16_t (*m)[3];
+
+	switch ((cmd >> 17) & 3) {
+	case 3: {
+		// not a real matrix, this is what the hardware ends up reading
+		int16_t r = gte->rgbc[0] << 4;
+
+		garbage[0][0] = -r;
+		garbage[0][1] = r;
+		garbage[0][2] = gte->ir[0];
+
+		for (int i = 0; i < 3; ++i) {
+			garbage[1][i] = gte->m[0][0][2];
+			garbage[2][i] = gte->m[0][1][1];
+		}
+
+		m = garbage;
+		break;
+	}
+	default:
+		m = gte->m[(cmd >> 17) & 3];
+	}
+
+	int16_t* v;
+	uint32_t vi = (cmd >> 15) & 3;
+
+	if (vi == 3) {
+		v = &gte->ir[1];
+	} else {
+		v = gte->v[vi];
+	}
+
+	int16_t x = v[0];
+	int16_t y = v[1];
+	int16_t z = v[2];
+
+	switch ((cmd >> 13) & 3) {
+	case 2:
+		gte_mul_mat_vec_fc(gte, m, x, y, z, shift, lm);
+		break;
+	case 3:
+		gte_mul_mat_vec(gte, m, GTE_NO_TRANSLATION, x, y, z, shift, lm);
+		break;
+	default:
+		gte_mul_mat_vec(gte, m, gte->t[(cmd >> 13) & 3], x, y, z, shift, lm);
+	}
+}
+
+void gte_command(Gte* gte, uint32_t cmd) {
+	int shift = (cmd & (1 << 19)) != 0 ? 12 : 0;
+	char lm = (cmd >> 10) & 1;
+
+	gte->flag = 0;
+
+	switch (cmd & 0x3f) {
+	case 0x01: // RTPS
+		gte_rtp(gte, gte->v[0], shift, lm, 1);
+		break;
+	case 0x06: { // NCLIP
+		int64_t x0 = gte->sxy[0][0], y0 = gte->sxy[0][1];
+		int64_t x1 = gte->sxy[1][0], y1 = gte->sxy[1][1];
+		int64_t x2 = gte->sxy[2][0], y2 = gte->sxy[2][1];
+
+		gte_set_mac0(gte, x0 * y1 + x1 * y2 + x2 * y0 - x0 * y2 - x1 * y0 - x2 * y1);
+		break;
+	}
+	case 0x0c: { // OP
+		int64_t d1 = gte->m[0][0][0];
+		int64_t d2 = gte->m[0][1][1];
+		int64_t d3 = gte->m[0][2][2];
+		int64_t ir1 = gte->ir[1];
+		int64_t ir2 = gte->ir[2];
+		int64_t ir3 = gte->ir[3];
+
+		gte_set_mac_ir(gte, 1, ir3 * d2 - ir2 * d3, shift, lm);
+		gte_set_mac_ir(gte, 2, ir1 * d3 - ir3 * d1, shift, lm);
+		gte_set_mac_ir(gte, 3, ir2 * d1 - ir1 * d2, shift, lm);
+		break;
+	}
+	case 0x10: // DPCS
+		gte_dpc(gte, gte->rgbc, shift, lm);
+		break;
+	case 0x11: { // INTPL
+		int64_t in[3];
+
+		for (int i = 0; i < 3; ++i) {
+			in[i] = (int64_t)gte->ir[i + 1] << 12;
+		}
+
+		gte_interpolate(gte, in, shift, lm);
+		gte_push_color(gte);
+		break;
+	}
+	case 0x12:
+		gte_mvmva(gte, cmd, shift, lm);
+		break;
+	case 0x13: // NCDS
+		gte_nc(gte, gte->v[0], shift, lm);
+		gte_depth_cue(gte, shift, lm);
+		break;
+	case 0x14: // CDP
+		gte_mul_mat_vec(gte, gte->m[2], gte->t[1], gte->ir[1], gte->ir[2], gte->ir[3], shift, lm);
+		gte_depth_cue(gte, shift, lm);
+		break;
+	case 0x16: // NCDT
+		for (int i = 0; i < 3; ++i) {
+			gte_nc(gte, gte->v[i], shift, lm);
+			gte_depth_cue(gte, shift, lm);
+		}
+		break;
+	case 0x1b: // NCCS
+		gte_nc(gte, gte->v[0], shift, lm);
+		gte_color(gte, shift, lm);
+		break;
+	case 0x1c: // CC
+		gte_mul_mat_vec(gte, gte->m[2], gte->t[1], gte->ir[1], gte->ir[2], gte->ir[3], shift, lm);
+		gte_color(gte, shift, lm);
+		break;
+	case 0x1e: // NCS
+		gte_nc(gte, gte->v[0], shift, lm);
+		gte_push_color(gte);
+		break;
+	case 0x20: // NCT
+		for (int i = 0; i < 3; ++i) {
+			gte_nc(gte, gte->v[i], shift, lm);
+			gte_push_color(gte);
+		}
+		break;
+	case 0x28: // SQR
+		for (int i = 1; i < 4; ++i) {
+			gte_set_mac_ir(gte, i, (int64_t)gte->ir[i] * gte->ir[i], shift, lm);
+		}
+		break;
+	case 0x29: // DCPL
+		gte_depth_cue(gte, shift, lm);
+		break;
+	case 0x2a: // DPCT
+		for (int i = 0; i < 3; ++i) {
+			gte_dpc(gte, gte->rgb[0], shift, lm);
+		}
+		break;
+	case 0x2d: { // AVSZ3
+		int64_t v = (int64_t)gte->zsf3 * (gte->sz[1] + gte->sz[2] + gte->sz[3]);
+
+		gte_set_mac0(gte, v);
+		gte->otz = gte_saturate_z(gte, v >> 12);
+		break;
+	}
+	case 0x2e: { // AVSZ4
+		int64_t v = (int64_t)gte->zsf4 * (gte->sz[0] + gte->sz[1] + gte->sz[2] + gte->sz[3]);
+
+		gte_set_mac0(gte, v);
+		gte->otz = gte_saturate_z(gte, v >> 12);
+		break;
+	}
+	case 0x30: // RTPT
+		gte_rtp(gte, gte->v[0], shift, lm, 0);
+		gte_rtp(gte, gte->v[1], shift, lm, 0);
+		gte_rtp(gte, gte->v[2], shift, lm, 1);
+		break;
+	case 0x3d: // GPF
+		for (int i = 1; i < 4; ++i) {
+			gte_set_mac_ir(gte, i, (int64_t)gte->ir[i] * gte->ir[0], shift, lm);
+		}
+
+		gte_push_color(gte);
+		break;
+	case 0x3e: // GPL
+		for (int i = 1; i < 4; ++i) {
+			gte_set_mac_ir(gte, i, ((int64_t)gte->mac[i] << shift) + (int64_t)gte->ir[i] * gte->ir[0], shift, lm);
+		}
+
+		gte_push_color(gte);
+		break;
+	case 0x3f: // NCCT
+		for (int i = 0; i < 3; ++i) {
+			gte_nc(gte, gte->v[i], shift, lm);
+			gte_color(gte, shift, lm);
+		}
+		break;
+	default:
+		printf("unknown gte command: %x\n", cmd & 0x3f);
+		break;
+	}
+
+	if ((gte->flag & GTE_FLAG_ERROR_MASK) != 0) {
+		gte->flag |= 1 << 31;
+	}
+}
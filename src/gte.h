@@ -0,0 +1,48 @@
+#ifndef GTE_H
+#define GTE_H
+
+#include <stdint.h>
+
+// bits of FLAG that also set the error bit 31
+#define GTE_FLAG_ERROR_MASK 0x7f87e000
+
+// Geometry Transformation Engine, coprocessor 2. Fields hold the registers
+// unpacked the way the commands use them, the packed forms are only built on
+// mfc2/cfc2. Ordered by size so there is no padding and lockstep can memcmp it.
+typedef struct {
+    // control registers
+    int32_t t[3][3]; // translation, background color, far color
+    int32_t ofx;
+    int32_t ofy;
+    int32_t dqb;
+    uint32_t flag;
+
+    // data registers
+    int32_t mac[4];
+    uint32_t res1;
+    uint32_t lzcs;
+    uint32_t lzcr;
+
+    int16_t m[3][3][3]; // rotation, light, light color
+    uint16_t h;
+    int16_t dqa;
+    int16_t zsf3;
+    int16_t zsf4;
+
+    int16_t v[3][3]; // V0-V2: x, y, z
+    int16_t ir[4];
+    int16_t sxy[3][2]; // screen xy fifo
+    uint16_t sz[4]; // screen z fifo
+    uint16_t otz;
+    uint8_t rgbc[4];
+    uint8_t rgb[3][4]; // color fifo
+} Gte;
+
+void gte_reset(Gte* gte);
+uint32_t gte_read_data(Gte* gte, uint32_t r);
+void gte_write_data(Gte* gte, uint32_t r, uint32_t v);
+uint32_t gte_read_control(Gte* gte, uint32_t r);
+void gte_write_control(Gte* gte, uint32_t r, uint32_t v);
+void gte_command(Gte* gte, uint32_t cmd);
+
+#endif
@@ -0,0 +1,406 @@
+#include "hle.h"
+
+#include "cpu.h"
+#include "bench.h"
+
+// argument n of the call, the fifth one on is passed on the stack
+uint32_t hle_arg(Cpu* cpu, uint32_t n) {
+	if (n < 4) {
+		return cpu->regs[4 + n];
+	}
+
+	return cpu_load32(cpu, cpu->regs[29] + n * 4);
+}
+
+uint32_t hle_strlen(Cpu* cpu, Hle* hle) {
+	uint32_t s = hle_arg(cpu, 0);
+	uint32_t len = 0;
+
+	if (s == 0) {
+		return 0;
+	}
+
+	while (cpu_load8(cpu, s + len) != 0) {
+		len += 1;
+	}
+
+	return len;
+}
+
+uint32_t hle_memcpy(Cpu* cpu, Hle* hle) {
+	uint32_t dst = hle_arg(cpu, 0);
+	uint32_t src = hle_arg(cpu, 1);
+	int32_t len = hle_arg(cpu, 2);
+
+	if (dst == 0) {
+		return 0;
+	}
+
+	for (int32_t i = 0; i < len; ++i) {
+		cpu_store8(cpu, dst + i, cpu_load8(cpu, src + i));
+	}
+
+	return dst;
+}
+
+uint32_t hle_memset(Cpu* cpu, Hle* hle) {
+	uint32_t dst = hle_arg(cpu, 0);
+	uint8_t v = hle_arg(cpu, 1);
+	int32_t len = hle_arg(cpu, 2);
+
+	if (dst == 0) {
+		return 0;
+	}
+
+	for (int32_t i = 0; i < len; ++i) {
+		cpu_store8(cpu, dst + i, v);
+	}
+
+	return dst;
+}
+
+// Heap blocks start with a header word: size of the block including the
+// header, bit 0 set while allocated. Sizes are multiples of 4.
+
+uint32_t hle_init_heap(Cpu* cpu, Hle* hle) {
+	uint32_t addr = (hle_arg(cpu, 0) + 3) & ~3;
+	uint32_t size = hle_arg(cpu, 1) & ~3;
+
+	hle->heap_start = addr;
+	hle->heap_end = addr + size;
+
+	cpu_store32(cpu, addr, size);
+
+	return 0;
+}
+
+uint32_t hle_heap_alloc(Cpu* cpu, Hle* hle, uint32_t n) {
+	uint32_t need = ((n + 3) & ~3) + 4;
+
+	for (uint32_t addr = hle->heap_start; addr < hle->heap_end;) {
+		uint32_t header = cpu_load32(cpu, addr);
+		uint32_t size = header & ~3;
+
+		if (size == 0) {
+			break;
+		}
+
+		if ((header & 1) == 0) {
+			// merge the free blocks that follow
+			while (addr + size < hle->heap_end) {
+				uint32_t next = cpu_load32(cpu, addr + size);
+
+				if ((next & 1) == 1 || (next & ~3) == 0) {
+					break;
+				}
+
+				size += next & ~3;
+			}
+
+			if (size >= need) {
+				if (size - need >= 8) {
+					cpu_store32(cpu, addr + need, size - need);
+					size = need;
+				}
+
+				cpu_store32(cpu, addr, size | 1);
+				return addr + 4;
+			}
+
+			cpu_store32(cpu, addr, size);
+		}
+
+		addr += size;
+	}
+
+	return 0;
+}
+
+uint32_t hle_malloc(Cpu* cpu, Hle* hle) {
+	return hle_heap_alloc(cpu, hle, hle_arg(cpu, 0));
+}
+
+uint32_t hle_free(Cpu* cpu, Hle* hle) {
+	uint32_t p = hle_arg(cpu, 0);
+
+	if (p >= hle->heap_start + 4 && p < hle->heap_end) {
+		cpu_store32(cpu, p - 4, cpu_load32(cpu, p - 4) & ~3);
+	}
+
+	return 0;
+}
+
+uint32_t hle_calloc(Cpu* cpu, Hle* hle) {
+	uint32_t n = hle_arg(cpu, 0) * hle_arg(cpu, 1);
+	uint32_t p = hle_heap_alloc(cpu, hle, n);
+
+	for (uint32_t i = 0; p != 0 && i < n; ++i) {
+		cpu_store8(cpu, p + i, 0);
+	}
+
+	return p;
+}
+
+uint32_t hle_realloc(Cpu* cpu, Hle* hle) {
+	uint32_t old = hle_arg(cpu, 0);
+	uint32_t n = hle_arg(cpu, 1);
+
+	if (old == 0) {
+		return hle_heap_alloc(cpu, hle, n);
+	}
+
+	uint32_t old_size = (cpu_load32(cpu, old - 4) & ~3) - 4;
+	uint32_t p = hle_heap_alloc(cpu, hle, n);
+
+	// the old block stays as it was when there is no room
+	if (p == 0) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < old_size && i < n; ++i) {
+		cpu_store8(cpu, p + i, cpu_load8(cpu, old + i));
+	}
+
+	cpu_store32(cpu, old - 4, cpu_load32(cpu, old - 4) & ~3);
+
+	return p;
+}
+
+uint32_t hle_putchar(Cpu* cpu, Hle* hle) {
+	uint8_t c = hle_arg(cpu, 0);
+
+	putchar(c);
+
+	return c;
+}
+
+uint32_t hle_puts(Cpu* cpu, Hle* hle) {
+	uint32_t s = hle_arg(cpu, 0);
+
+	for (uint8_t c; s != 0 && (c = cpu_load8(cpu, s)) != 0; ++s) {
+		putchar(c);
+	}
+
+	return 0;
+}
+
+// the subset of printf the kernel supports: flags, width and d i u x X c s p
+uint32_t hle_printf(Cpu* cpu, Hle* hle) {
+	uint32_t fmt = hle_arg(cpu, 0);
+	uint32_t arg = 1;
+	uint32_t written = 0;
+	char spec[16];
+	char out[256];
+
+	for (uint8_t c; (c = cpu_load8(cpu, fmt)) != 0; ++fmt) {
+		if (c != '%') {
+			putchar(c);
+			written += 1;
+			continue;
+		}
+
+		uint32_t len = 0;
+		spec[len++] = '%';
+
+		for (fmt += 1; (c = cpu_load8(cpu, fmt)) != 0 && len < sizeof(spec) - 2; fmt += 1) {
+			if (strchr("-+ #0123456789.", c) == NULL) {
+				break;
+			}
+			spec[len++] = c;
+		}
+
+		switch (c) {
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'c':
+			spec[len++] = c;
+			spec[len] = 0;
+			written += snprintf(out, sizeof(out), spec, hle_arg(cpu, arg++));
+			fputs(out, stdout);
+			break;
+		case 'p':
+			written += printf("%x", hle_arg(cpu, arg++));
+			break;
+		case 's': {
+			uint32_t s = hle_arg(cpu, arg++);
+			uint32_t n = 0;
+
+			spec[len++] = 's';
+			spec[len] = 0;
+
+			while (s != 0 && n < sizeof(out) - 1 && (out[n] = cpu_load8(cpu, s + n)) != 0) {
+				n += 1;
+			}
+			out[n] = 0;
+
+			written += printf(spec, out);
+			break;
+		}
+		case '%':
+			putchar('%');
+			written += 1;
+			break;
+		case 0:
+			return written;
+		default:
+			putchar(c);
+			written += 1;
+		}
+	}
+
+	return written;
+}
+
+// The block cache already tracks every store to code, but the real call
+// invalidates the whole icache and ends with IsC going back to 0, which is
+// when stale blocks get collected.
+uint32_t hle_flush_cache(Cpu* cpu, Hle* hle) {
+	icache_reset(&cpu->icache);
+
+	if (cpu->cache != NULL) {
+		cpu->cache->collect = 1;
+	}
+
+	return 0;
+}
+
+HleFunction HLE_FUNCTIONS[] = {
+	{ HLE_A0, 0x1b, "strlen", hle_strlen },
+	{ HLE_A0, 0x2a, "memcpy", hle_memcpy },
+	{ HLE_A0, 0x2b, "memset", hle_memset },
+	{ HLE_A0, 0x33, "malloc", hle_malloc, 1 },
+	{ HLE_A0, 0x34, "free", hle_free, 1 },
+	{ HLE_A0, 0x37, "calloc", hle_calloc, 1 },
+	{ HLE_A0, 0x38, "realloc", hle_realloc, 1 },
+	{ HLE_A0, 0x39, "InitHeap", hle_init_heap, 1 },
+	{ HLE_A0, 0x3c, "putchar", hle_putchar },
+	{ HLE_A0, 0x3e, "puts", hle_puts },
+	{ HLE_A0, 0x3f, "printf", hle_printf },
+	{ HLE_A0, 0x44, "FlushCache", hle_flush_cache },
+	{ HLE_B0, 0x3d, "std_out_putchar", hle_putchar },
+	{ HLE_B0, 0x3f, "std_out_puts", hle_puts },
+};
+
+Hle* initialize_hle() {
+	Hle* hle = malloc(sizeof(Hle));
+
+	hle->functions = HLE_FUNCTIONS;
+	hle->count = sizeof(HLE_FUNCTIONS) / sizeof(HLE_FUNCTIONS[0]);
+	hle->heap_start = 0;
+	hle->heap_end = 0;
+
+	for (int i = 0; i < hle->count; ++i) {
+		hle->functions[i].enabled = 1;
+		hle->functions[i].calls = 0;
+		hle->functions[i].time = 0;
+	}
+
+	return hle;
+}
+
+// name is a function name or vector:number such as a0:2a, "heap" switches
+// all the heap functions
+void hle_set_enabled(Hle* hle, const char* name, char enabled) {
+	char found = 0;
+
+	for (int i = 0; i < hle->count; ++i) {
+		HleFunction* f = &hle->functions[i];
+		char id[8];
+
+		snprintf(id, sizeof(id), "%x:%x", f->vector, f->number);
+
+		if (strcmp(name, f->name) == 0 || strcmp(name, id) == 0
+		    || (strcmp(name, "heap") == 0 && f->heap == 1)) {
+			found = 1;
+
+			// half of the heap in C and half in the guest would corrupt it
+			if (f->heap == 1 && strcmp(name, "heap") != 0) {
+				return hle_set_enabled(hle, "heap", enabled);
+			}
+
+			f->enabled = enabled;
+		}
+	}
+
+	if (found == 0) {
+		printf("unknown hle function: %s\n", name);
+		exit(1);
+	}
+}
+
+char hle_vector(Cpu* cpu) {
+	if (cpu->hle == NULL) {
+		return 0;
+	}
+
+	uint32_t phys = mask_region(cpu->pc);
+
+	return phys == HLE_A0 || phys == HLE_B0 || phys == HLE_C0;
+}
+
+// Called when the cpu fetches from the first page with HLE on. Returns 1 if
+// a kernel call was run natively, execution then continues at ra.
+char hle_call(Cpu* cpu, uint32_t phys) {
+	if (phys != HLE_A0 && phys != HLE_B0 && phys != HLE_C0) {
+		return 0;
+	}
+
+	Hle* hle = cpu->hle;
+	uint32_t number = cpu->regs[9];
+	HleFunction* f = NULL;
+
+	for (int i = 0; i < hle->count; ++i) {
+		if (hle->functions[i].vector == phys && hle->functions[i].number == number) {
+			f = &hle->functions[i];
+			break;
+		}
+	}
+
+	if (f == NULL || f->enabled == 0) {
+		return 0;
+	}
+
+	// the load from the delay slot of the call lands before the first
+	// instruction of the function would have run
+	cpu->regs[cpu->load[0]] = cpu->load[1];
+	cpu->regs[0] = 0;
+	cpu->load[0] = 0;
+	cpu->load[1] = 0;
+
+	double start = bench_now();
+	uint32_t v = f->handler(cpu, hle);
+	f->time += bench_now() - start;
+	f->calls += 1;
+
+	set_reg(cpu, 2, v);
+	cpu->next_pc = cpu->regs[31];
+
+	return 1;
+}
+
+void hle_report(Hle* hle) {
+	printf("hle: function calls time\n");
+
+	for (int i = 0; i < hle->count; ++i) {
+		HleFunction* f = &hle->functions[i];
+
+		if (f->calls > 0 || f->enabled == 0) {
+			printf("hle: %02x:%02x %-16s %10llu %10.6f s%s\n", f->vector, f->number, f->name,
+			       (unsigned long long)f->calls, f->time, f->enabled == 0 ? " (lle)" : "");
+		}
+	}
+}
+
+Hle* hle_exit_report = NULL;
+
+void hle_exit() {
+	hle_report(hle_exit_report);
+}
+
+void hle_report_at_exit(Hle* hle) {
+	hle_exit_report = hle;
+	atexit(hle_exit);
+}
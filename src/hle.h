@@ -0,0 +1,44 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include <stdint.h>
+
+// kernel call vectors, the function number is in t1
+#define HLE_A0 0xa0
+#define HLE_B0 0xb0
+#define HLE_C0 0xc0
+
+typedef struct Cpu Cpu;
+typedef struct Hle Hle;
+
+typedef uint32_t (*HleHandler)(Cpu* cpu, Hle* hle);
+
+typedef struct {
+    uint32_t vector;
+    uint32_t number;
+    const char* name;
+    HleHandler handler;
+    char heap; // the heap functions share state and are switched together
+
+    char enabled;
+    uint64_t calls;
+    double time; // seconds spent in the handler
+} HleFunction;
+
+typedef struct Hle {
+    HleFunction* functions;
+    uint32_t count;
+
+    // guest heap set up by InitHeap
+    uint32_t heap_start;
+    uint32_t heap_end;
+} Hle;
+
+Hle* initialize_hle();
+void hle_set_enabled(Hle* hle, const char* name, char enabled);
+char hle_vector(Cpu* cpu);
+char hle_call(Cpu* cpu, uint32_t phys);
+void hle_report(Hle* hle);
+void hle_report_at_exit(Hle* hle);
+
+#endif
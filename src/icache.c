@@ -0,0 +1,33 @@
+#include "icache.h"
+
+#include "timing.h"
+
+void icache_reset(ICache* icache) {
+	for (int i = 0; i < ICACHE_LINES; ++i) {
+		icache->tag[i] = 0;
+		icache->valid[i] = 0;
+	}
+}
+
+// Returns the cycles a fetch costs on top of a hit. A miss refills the line
+// from the fetched word to its end, one bus read and then a cycle per word.
+uint32_t icache_fetch(ICache* icache, uint8_t* regions, uint32_t pc) {
+	uint32_t line = (pc >> ICACHE_LINE_SHIFT) & (ICACHE_LINES - 1);
+	uint32_t word = (pc >> 2) & (ICACHE_LINE_WORDS - 1);
+	uint32_t tag = pc & ICACHE_TAG_MASK;
+
+	if (icache->tag[line] == tag && (icache->valid[line] & (1 << word)) != 0) {
+		return 0;
+	}
+
+	icache->tag[line] = tag;
+	icache->valid[line] = (0xf << word) & 0xf;
+
+	return LOAD_CYCLES[2][regions[pc >> TIMING_PAGE_SHIFT]] + ICACHE_LINE_WORDS - 1 - word;
+}
+
+// with the cache isolated stores land in the cache instead of memory, the
+// BIOS writes every line this way to flush it
+void icache_isolated_store(ICache* icache, uint32_t addr) {
+	icache->valid[(addr >> ICACHE_LINE_SHIFT) & (ICACHE_LINES - 1)] = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef ICACHE_H
+#define ICACHE_H
+
+#include <stdint.h>
+
+// 4 kB direct mapped instruction cache in 16 byte lines
+#define ICACHE_LINES 256
+#define ICACHE_LINE_SHIFT 4
+#define ICACHE_LINE_WORDS 4
+// physical address bits above the line index
+#define ICACHE_TAG_MASK 0x1ffff000
+// KUSEG and KSEG0 go through the cache, KSEG1 and KSEG2 don't
+#define ICACHE_UNCACHED 0xa0000000
+
+// Only tags and valid bits are kept, the instructions themselves come from
+// the predecoded pages, so the cache only decides what a fetch costs.
+typedef struct {
+    uint32_t tag[ICACHE_LINES];
+    uint8_t valid[ICACHE_LINES]; // one bit per word of the line
+} ICache;
+
+void icache_reset(ICache* icache);
+uint32_t icache_fetch(ICache* icache, uint8_t* regions, uint32_t pc);
+void icache_isolated_store(ICache* icache, uint32_t addr);
+
+#endif
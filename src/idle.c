@@ -0,0 +1,90 @@
+#include "idle.h"
+
+#include "cpu.h"
+
+void initialize_idle(IdleLoop* idle) {
+	idle->pc = 0;
+	idle->pure = 0;
+	idle->valid = 0;
+	idle->enabled = 1;
+	idle->skipped = 0;
+}
+
+char idle_op_pure(OpHandler h) {
+	return h == op_lui || h == op_ori || h == op_andi || h == op_xori || h == op_addiu
+		|| h == op_slti || h == op_sltiu || h == op_addu || h == op_subu || h == op_and
+		|| h == op_or || h == op_xor || h == op_nor || h == op_slt || h == op_sltu
+		|| h == op_sll || h == op_srl || h == op_sra || h == op_sllv || h == op_srlv
+		|| h == op_srav || h == op_mfhi || h == op_mflo
+		|| h == op_lw || h == op_lh || h == op_lhu || h == op_lb || h == op_lbu
+		|| h == op_beq || h == op_bne || h == op_blez || h == op_bgtz || h == op_bltz
+		|| h == op_bgez || h == op_j;
+}
+
+// 1 if every instruction from start up to the delay slot after end only
+// computes registers or loads, never stores or touches cop0
+char idle_scan(Cpu* cpu, uint32_t start, uint32_t end) {
+	for (uint32_t addr = start; addr <= end + 4; addr += 4) {
+		MemPage* page = intr_page(cpu->intr, mask_region(addr));
+
+		// never read code through mmio
+		if (page == NULL || page->read == NULL) {
+			return 0;
+		}
+
+		if (idle_op_pure(op_handler(intr_load32(cpu->intr, addr))) == 0) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// Called on every taken backward branch. If the loop is side effect free and
+// a whole iteration left the registers untouched, every further iteration
+// will read the same values until a device changes state, which only
+// happens through a scheduled event, so the clock jumps straight to it.
+void idle_branch(Cpu* cpu, uint32_t target) {
+	IdleLoop* idle = &cpu->idle;
+	uint32_t pc = cpu->curr_pc;
+
+	if (idle->enabled == 0 || pc - target > IDLE_MAX_OPS * 4) {
+		return;
+	}
+
+	if (pc != idle->pc) {
+		idle->pc = pc;
+		idle->pure = idle_scan(cpu, target, pc);
+		idle->valid = 0;
+	}
+
+	if (idle->pure == 0) {
+		return;
+	}
+
+	if (idle->valid == 1
+	    && memcmp(idle->regs, cpu->regs, sizeof(cpu->regs)) == 0
+	    && idle->hi == cpu->hi && idle->lo == cpu->lo
+	    && idle->load[0] == cpu->load[0] && idle->load[1] == cpu->load[1]) {
+		// the code might have been rewritten since the loop was scanned
+		if (cpu->deadline > cpu->cycles && idle_scan(cpu, target, pc) == 1) {
+			idle->skipped += cpu->deadline - cpu->cycles;
+			cpu->cycles = cpu->deadline;
+		}
+
+		return;
+	}
+
+	memcpy(idle->regs, cpu->regs, sizeof(cpu->regs));
+	idle->hi = cpu->hi;
+	idle->lo = cpu->lo;
+	idle->load[0] = cpu->load[0];
+	idle->load[1] = cpu->load[1];
+	idle->valid = 1;
+}
+
+// Called on every other branch, taken or not, and on exceptions, so a loop
+// left and entered again never compares against its previous visit.
+void idle_leave(Cpu* cpu) {
+	cpu->idle.valid = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+// longest loop body (without the delay slot) considered for skipping
+#define IDLE_MAX_OPS 16
+
+typedef struct Cpu Cpu;
+
+// the last short backward branch taken and the state it was taken in
+typedef struct {
+    uint32_t pc;
+    char pure; // loop body has no side effects besides loads
+    char valid; // the snapshot below is from the iteration just before
+
+    uint32_t regs[32];
+    uint32_t hi;
+    uint32_t lo;
+    uint32_t load[2];
+
+    char enabled;
+    uint64_t skipped; // cycles fast-forwarded
+} IdleLoop;
+
+void initialize_idle(IdleLoop* idle);
+char idle_scan(Cpu* cpu, uint32_t start, uint32_t end);
+void idle_branch(Cpu* cpu, uint32_t target);
+void idle_leave(Cpu* cpu);
+
+#endif
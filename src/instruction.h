@@ -50,4 +50,54 @@ uint32_t instr_subfunction(Instruction instr) {
     return instr & 0x3f;
 }
 
+// Fields of an instruction extracted once, handlers read these instead of
+// decoding the word on every execution
+typedef struct {
+    Instruction word;
+    uint32_t pc; // address it was decoded for, the branch target depends on it
+    uint32_t imm;
+    uint32_t imm_se;
+    uint32_t target; // destination of a taken branch or jump
+    uint8_t id; // index into HANDLERS
+    uint8_t s;
+    uint8_t t;
+    uint8_t d;
+    uint8_t shift;
+    uint8_t cycles; // fetch and execute, data accesses are added as they happen
+    uint8_t icache; // fetched through the icache, which may add a refill
+} Decoded;
+
+// pc of an entry that was never decoded, no instruction is fetched from there
+#define DECODED_NONE 0xffffffff
+
+void instr_decode(Decoded* op, Instruction instr, uint32_t pc) {
+    uint32_t function = instr_function(instr);
+
+    op->word = instr;
+    op->pc = pc;
+    op->imm = instr_imm(instr);
+    op->imm_se = instr_imm_se(instr);
+    op->id = function == 0 ? 64 | instr_subfunction(instr) : function;
+    op->s = instr_s(instr);
+    op->t = instr_t(instr);
+    op->d = instr_d(instr);
+    op->shift = instr_shift(instr);
+
+    switch (function) {
+    case 0b000010: // j
+    case 0b000011: // jal
+        op->target = ((pc + 4) & 0xf0000000) | (instr_imm_jump(instr) << 2);
+        break;
+    case 0b000001: // bcondz
+    case 0b000100: // beq
+    case 0b000101: // bne
+    case 0b000110: // blez
+    case 0b000111: // bgtz
+        op->target = pc + 4 + (op->imm_se << 2);
+        break;
+    default:
+        op->target = 0;
+    }
+}
+
 #endif
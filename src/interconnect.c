@@ -21,35 +21,150 @@ Range CACHE_CONTROL = { 0xfffe0130, 4 };
 Range SPU_RANGE = { 0x1f801c00, 640 };
 Range EXPANSION_1 = { 0x1f000000, 1024 * 1024 * 8 };
 Range EXPANSION_2 = { 0x1f802000, 66 };
-Range SCRATCHPAD = { 0x1f800000, 1024 };
+Range SCRATCHPAD = { 0x1f800000, SCRATCHPAD_SIZE };
 Range IRQ_CONTROL = { 0x1f801070, 8 };
 // TODO: check real value
 Range TIMERS = { 0x1f801100, 50 };
 Range DMA = { 0x1f801080, 0x80 };
 Range GPU = {  0x1f801810, 8 };
 
-Interconnect* initialize_interconnect(Bios* bios, Ram* ram, Dma* dma, Gpu* gpu) {
+Interconnect* initialize_interconnect(Bios* bios, Ram* ram, Dma* dma, Gpu* gpu, Scheduler* scheduler) {
 	Interconnect* intr = malloc(sizeof(Interconnect));
 	intr->bios = bios;
 	intr->ram = ram;
 	intr->dma = dma;
 	intr->gpu = gpu;
+	intr->scheduler = scheduler;
+	intr->fastmem = NULL;
+	intr->cache = NULL;
+
+	memset(intr->scratchpad, 0, SCRATCHPAD_SIZE);
+
+	intr_map_pages(intr);
+
 	return intr;
 }
 
+void intr_map_pages(Interconnect* intr) {
+	for (int i = 0; i < MEM_PAGE_COUNT; ++i) {
+		intr->pages[i].read = NULL;
+		intr->pages[i].write = NULL;
+	}
+
+	for (uint32_t offset = 0; offset < RAM_SIZE; offset += 1 << MEM_PAGE_SHIFT) {
+		MemPage* page = &intr->pages[(RAM_RANGE[0] + offset) >> MEM_PAGE_SHIFT];
+		page->read = intr->ram->data + offset;
+		page->write = intr->ram->data + offset;
+	}
+
+	for (uint32_t offset = 0; offset < BIOS_SIZE; offset += 1 << MEM_PAGE_SHIFT) {
+		MemPage* page = &intr->pages[(BIOS_RANGE[0] + offset) >> MEM_PAGE_SHIFT];
+		page->read = intr->bios->data + offset;
+	}
+}
+
+// NULL for addresses above the physical space (cache control)
+MemPage* intr_page(Interconnect* intr, uint32_t addr) {
+	if (addr >= MEM_PAGE_COUNT << MEM_PAGE_SHIFT) {
+		return NULL;
+	}
+
+	return &intr->pages[addr >> MEM_PAGE_SHIFT];
+}
+
 uint32_t intr_load32(Interconnect* intr, uint32_t addr) {
 	addr = mask_region(addr);
 
-	if (range_contains(BIOS_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(BIOS_RANGE, addr);	
+	MemPage* page = intr_page(intr, addr);
 
-		return bios_load32(intr->bios, offset);
+	if (page != NULL && page->read != NULL) {
+		uint32_t v;
+		memcpy(&v, page->read + (addr & MEM_PAGE_MASK), 4);
+		return v;
+	}
+
+	return intr_mmio_load32(intr, addr);
+}
+
+uint16_t intr_load16(Interconnect* intr, uint32_t addr) {
+	addr = mask_region(addr);
+
+	MemPage* page = intr_page(intr, addr);
+
+	if (page != NULL && page->read != NULL) {
+		uint16_t v;
+		memcpy(&v, page->read + (addr & MEM_PAGE_MASK), 2);
+		return v;
+	}
+
+	return intr_mmio_load16(intr, addr);
+}
+
+uint8_t intr_load8(Interconnect* intr, uint32_t addr) {
+	addr = mask_region(addr);
+
+	MemPage* page = intr_page(intr, addr);
+
+	if (page != NULL && page->read != NULL) {
+		return page->read[addr & MEM_PAGE_MASK];
+	}
+
+	return intr_mmio_load8(intr, addr);
+}
+
+// BIOS pages have no write pointer, stores to them end up in the mmio path
+
+void intr_store32(Interconnect* intr, uint32_t addr, uint32_t v) {
+	addr = mask_region(addr);
+
+	MemPage* page = intr_page(intr, addr);
+
+	if (page != NULL && page->write != NULL) {
+		memcpy(page->write + (addr & MEM_PAGE_MASK), &v, 4);
+		return;
+	}
+
+	intr_mmio_store32(intr, addr, v);
+}
+
+void intr_store16(Interconnect* intr, uint32_t addr, uint16_t v) {
+	addr = mask_region(addr);
+
+	MemPage* page = intr_page(intr, addr);
+
+	if (page != NULL && page->write != NULL) {
+		memcpy(page->write + (addr & MEM_PAGE_MASK), &v, 2);
+		return;
 	}
-    
-	if (range_contains(RAM_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(RAM_RANGE, addr);
 
-		return ram_load32(intr->ram, offset);
+	intr_mmio_store16(intr, addr, v);
+}
+
+void intr_store8(Interconnect* intr, uint32_t addr, uint8_t v) {
+	addr = mask_region(addr);
+
+	MemPage* page = intr_page(intr, addr);
+
+	if (page != NULL && page->write != NULL) {
+		page->write[addr & MEM_PAGE_MASK] = v;
+		return;
+	}
+
+	intr_mmio_store8(intr, addr, v);
+}
+
+// scratchpad shares its page with the io ports, so it can't be in the page
+// table. Games use it as fast RAM in their inner loops, it is checked before
+// every device.
+char intr_scratchpad(uint32_t addr) {
+	return addr - SCRATCHPAD[0] < SCRATCHPAD_SIZE;
+}
+
+uint32_t intr_mmio_load32(Interconnect* intr, uint32_t addr) {
+	if (intr_scratchpad(addr) == 1) {
+		uint32_t v;
+		memcpy(&v, intr->scratchpad + range_offset(SCRATCHPAD, addr), 4);
+		return v;
 	}
 
 	if(range_contains(IRQ_CONTROL, addr) == 1) {
@@ -87,20 +202,18 @@ uint32_t intr_load32(Interconnect* intr, uint32_t addr) {
 	exit(1);
 }
 
-uint16_t intr_load16(Interconnect* intr, uint32_t addr) {    
-	addr = mask_region(addr);
+uint16_t intr_mmio_load16(Interconnect* intr, uint32_t addr) {
+	if (intr_scratchpad(addr) == 1) {
+		uint16_t v;
+		memcpy(&v, intr->scratchpad + range_offset(SCRATCHPAD, addr), 2);
+		return v;
+	}
 
 	if(range_contains(SPU_RANGE, addr) == 1) {
 		/* printf("unhandled spu load\n"); */
 		return 0;
 	}
 
-	if(range_contains(RAM_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(RAM_RANGE, addr);
-	
-		return ram_load16(intr->ram, offset);
-	}    
-
 	if(range_contains(IRQ_CONTROL, addr) == 1) {
 		return 0;
 	}
@@ -109,19 +222,9 @@ uint16_t intr_load16(Interconnect* intr, uint32_t addr) {
 	exit(1);
 }
 
-uint8_t intr_load8(Interconnect* intr, uint32_t addr) {    
-	addr = mask_region(addr);
-
-	if(range_contains(BIOS_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(BIOS_RANGE, addr);
-
-		return bios_load8(intr->bios, offset);
-	}
-
-	if(range_contains(RAM_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(RAM_RANGE, addr);
-
-		return ram_load8(intr->ram, offset);
+uint8_t intr_mmio_load8(Interconnect* intr, uint32_t addr) {
+	if (intr_scratchpad(addr) == 1) {
+		return intr->scratchpad[range_offset(SCRATCHPAD, addr)];
 	}
 
 	if(range_contains(EXPANSION_1, addr) == 1) {
@@ -133,9 +236,12 @@ uint8_t intr_load8(Interconnect* intr, uint32_t addr) {
 	exit(1);
 }
 
-void intr_store32(Interconnect* intr, uint32_t addr, uint32_t v) {
-	addr = mask_region(addr);
-    
+void intr_mmio_store32(Interconnect* intr, uint32_t addr, uint32_t v) {
+	if (intr_scratchpad(addr) == 1) {
+		memcpy(intr->scratchpad + range_offset(SCRATCHPAD, addr), &v, 4);
+		return;
+	}
+
 	// something related to RAM configuration    
 	if (range_contains(RAM_CONF_SIZE, addr) == 1) {
 		return;
@@ -167,12 +273,6 @@ void intr_store32(Interconnect* intr, uint32_t addr, uint32_t v) {
 	}
 
     
-	if(range_contains(RAM_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(RAM_RANGE, addr);
-
-		return ram_store32(intr->ram, offset, v);
-	}
-
 	if(range_contains(IRQ_CONTROL, addr) == 1) {
 		/* printf("unhandled irq store\n"); */
 		return;
@@ -208,8 +308,11 @@ void intr_store32(Interconnect* intr, uint32_t addr, uint32_t v) {
 	exit(1);
 }
 
-void intr_store16(Interconnect* intr, uint32_t addr, uint16_t v) {
-	addr = mask_region(addr);
+void intr_mmio_store16(Interconnect* intr, uint32_t addr, uint16_t v) {
+	if (intr_scratchpad(addr) == 1) {
+		memcpy(intr->scratchpad + range_offset(SCRATCHPAD, addr), &v, 2);
+		return;
+	}
 
 	if(range_contains(SPU_RANGE, addr) == 1) {
 		/* printf("unhandled write to spu register\n"); */
@@ -222,12 +325,6 @@ void intr_store16(Interconnect* intr, uint32_t addr, uint16_t v) {
 		return;
 	}
 
-	if(range_contains(RAM_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(RAM_RANGE, addr);
-	
-		return ram_store16(intr->ram, offset, v);
-	}
-
 	if(range_contains(IRQ_CONTROL, addr) == 1) {
 		return;
 	}
@@ -236,8 +333,11 @@ void intr_store16(Interconnect* intr, uint32_t addr, uint16_t v) {
 	exit(1);
 }
 
-void intr_store8(Interconnect* intr, uint32_t addr, uint8_t v) {
-	addr = mask_region(addr);
+void intr_mmio_store8(Interconnect* intr, uint32_t addr, uint8_t v) {
+	if (intr_scratchpad(addr) == 1) {
+		intr->scratchpad[range_offset(SCRATCHPAD, addr)] = v;
+		return;
+	}
 
 	if(range_contains(EXPANSION_2, addr) == 1) {
 		/* printf("unhandled store to expansion2\n"); */
@@ -245,14 +345,6 @@ void intr_store8(Interconnect* intr, uint32_t addr, uint8_t v) {
 		return;
 	}
 
-	if(range_contains(RAM_RANGE, addr) == 1) {
-		uint32_t offset = range_offset(RAM_RANGE, addr);
-
-		ram_store8(intr->ram, offset, v);
-	    
-		return;
-	}
-    
 	printf("unhandled store8: %x\n", addr);
 	exit(1);
 }
@@ -9,23 +9,58 @@
 #include "range.h"
 #include "ram.h"
 #include "gpu/gpu.h"
+#include "scheduler.h"
+
+// the masked physical space is split into 64 kB pages, RAM and BIOS pages point
+// straight at host memory, everything else goes through the mmio path
+#define MEM_PAGE_SHIFT 16
+#define MEM_PAGE_MASK ((1 << MEM_PAGE_SHIFT) - 1)
+#define MEM_PAGE_COUNT (0x20000000 >> MEM_PAGE_SHIFT)
+
+#define SCRATCHPAD_SIZE 1024
 
 typedef struct Dma Dma;
+typedef struct BlockCache BlockCache;
+
+typedef struct {
+    uint8_t* read; // NULL for mmio
+    uint8_t* write; // NULL for mmio and read only pages
+} MemPage;
 
 typedef struct Interconnect {
     Bios* bios;
     Ram* ram;
     Dma* dma;
     Gpu* gpu;
+    Scheduler* scheduler;
+
+    MemPage pages[MEM_PAGE_COUNT];
+
+    uint8_t scratchpad[SCRATCHPAD_SIZE];
+
+    // host window holding guest address a at fastmem + a, NULL when disabled
+    uint8_t* fastmem;
+
+    // block cache DMA writes into RAM invalidate, NULL when nothing is compiled
+    BlockCache* cache;
 } Interconnect;
 
-Interconnect* initialize_interconnect(Bios* bios, Ram* ram, Dma* dma, Gpu* gpu);
+Interconnect* initialize_interconnect(Bios* bios, Ram* ram, Dma* dma, Gpu* gpu, Scheduler* scheduler);
+void intr_map_pages(Interconnect* intr);
+MemPage* intr_page(Interconnect* intr, uint32_t addr);
 uint32_t intr_load32(Interconnect* intr, uint32_t addr);
 uint16_t intr_load16(Interconnect* intr, uint32_t addr);
 uint8_t intr_load8(Interconnect* intr, uint32_t addr);
 void intr_store32(Interconnect* intr, uint32_t addr, uint32_t v);
 void intr_store16(Interconnect* intr, uint32_t addr, uint16_t v);
 void intr_store8(Interconnect* intr, uint32_t addr, uint8_t v);
+char intr_scratchpad(uint32_t addr);
+uint32_t intr_mmio_load32(Interconnect* intr, uint32_t addr);
+uint16_t intr_mmio_load16(Interconnect* intr, uint32_t addr);
+uint8_t intr_mmio_load8(Interconnect* intr, uint32_t addr);
+void intr_mmio_store32(Interconnect* intr, uint32_t addr, uint32_t v);
+void intr_mmio_store16(Interconnect* intr, uint32_t addr, uint16_t v);
+void intr_mmio_store8(Interconnect* intr, uint32_t addr, uint8_t v);
 uint32_t mask_region(uint32_t addr);
 
 #endif
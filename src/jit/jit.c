@@ -0,0 +1,473 @@
+#include "jit.h"
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include "../cpu.h"
+
+#define CPU_OFF(f) ((uint32_t)offsetof(Cpu, f))
+#define REG(i) (CPU_OFF(regs) + (i) * 4)
+#define OP_OFF(i, f) ((uint32_t)(offsetof(Block, ops) + (i) * sizeof(BlockOp) + offsetof(BlockOp, f)))
+
+// where a fastmem access hands over to the handler of the i-th op, emitted
+// after the epilogue so the fast path falls straight through
+typedef struct {
+	uint32_t jumps[4];
+	uint32_t count;
+	uint32_t op;
+	uint32_t done;
+} JitSlowPath;
+
+Jit* initialize_jit() {
+	Jit* jit = malloc(sizeof(Jit));
+
+	jit->code = mmap(NULL, JIT_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (jit->code == MAP_FAILED) {
+		printf("failed to allocate jit code cache\n");
+		exit(1);
+	}
+
+	jit->used = 0;
+	jit->perf = NULL;
+	jit->count_ops = 0;
+	jit->icache_fetch = cpu_icache_fetch;
+	jit->fastmem = 0;
+
+	return jit;
+}
+
+void jit_flush(Jit* jit, BlockCache* cache) {
+	for (int i = 0; i < RAM_SIZE / 4; ++i) {
+		if (cache->ram_blocks[i] != NULL) {
+			cache->ram_blocks[i]->code = NULL;
+		}
+	}
+
+	for (int i = 0; i < BIOS_SIZE / 4; ++i) {
+		if (cache->bios_blocks[i] != NULL) {
+			cache->bios_blocks[i]->code = NULL;
+		}
+	}
+
+	jit->used = 0;
+}
+
+// regs[d] = v, where v is in eax. If a load may be pending it is cancelled
+// when it targets the same register, like set_reg does.
+void jit_set_reg(Emitter* e, uint32_t d, char load_pending) {
+	if (d == 0) {
+		return;
+	}
+
+	x86_store(e, REG(d), EAX);
+
+	if (load_pending == 1) {
+		x86_cmp_mem_imm8(e, CPU_OFF(load[0]), d);
+		uint32_t skip = x86_jcc(e, CC_NE);
+		x86_store_imm(e, CPU_OFF(load[0]), 0);
+		x86_patch(e, skip);
+	}
+}
+
+void jit_alu3(Emitter* e, uint8_t op, uint32_t s, uint32_t t, uint32_t d, char lp) {
+	x86_load(e, EAX, REG(s));
+	x86_alu(e, op, EAX, REG(t));
+	jit_set_reg(e, d, lp);
+}
+
+void jit_alu_imm(Emitter* e, uint8_t op, uint32_t s, uint32_t imm, uint32_t t, char lp) {
+	x86_load(e, EAX, REG(s));
+	x86_alu_imm(e, op, EAX, imm);
+	jit_set_reg(e, t, lp);
+}
+
+void jit_branch_taken(Emitter* e, uint32_t target) {
+	x86_store_imm(e, CPU_OFF(next_pc), target);
+	x86_store8_imm(e, CPU_OFF(branch), 1);
+}
+
+// branch if edx (cc) 0, the jump skips the taken path so cc is the inverse
+void jit_branch_zero(Emitter* e, uint8_t skip_cc, uint32_t target) {
+	x86_alu_imm(e, ALU_CMP, EDX, 0);
+	uint32_t skip = x86_jcc(e, skip_cc);
+	jit_branch_taken(e, target);
+	x86_patch(e, skip);
+}
+
+// the line and tag are known here, only a miss calls out
+void jit_icache_fetch(Emitter* e, Decoded* instr, uint32_t i) {
+	uint32_t line = (instr->pc >> ICACHE_LINE_SHIFT) & (ICACHE_LINES - 1);
+	uint32_t word = (instr->pc >> 2) & (ICACHE_LINE_WORDS - 1);
+
+	x86_cmp_mem_imm(e, CPU_OFF(icache.tag) + line * 4, instr->pc & ICACHE_TAG_MASK);
+	uint32_t miss = x86_jcc(e, CC_NE);
+	x86_test_mem8_imm(e, CPU_OFF(icache.valid) + line, 1 << word);
+	uint32_t hit = x86_jcc(e, CC_NE);
+	x86_patch(e, miss);
+	x86_load64(e, EAX, CPU_OFF(jit));
+	x86_call_args(e, OP_OFF(i, instr));
+	x86_call_ptr(e, EAX, (uint32_t)offsetof(Jit, icache_fetch));
+	x86_patch(e, hit);
+}
+
+// returns 1 if the op was translated, 0 if it falls back to the interpreter
+// handler, which is called through the i-th op of the block
+char jit_emit_op(Emitter* e, OpHandler handler, Decoded* instr, uint32_t i, char lp) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+	uint32_t d = instr->d;
+	uint32_t imm = instr->imm;
+	uint32_t imm_se = instr->imm_se;
+	uint32_t shift = instr->shift;
+
+	if (handler == op_addu) {
+		jit_alu3(e, ALU_ADD, s, t, d, lp);
+	} else if (handler == op_subu) {
+		jit_alu3(e, ALU_SUB, s, t, d, lp);
+	} else if (handler == op_and) {
+		jit_alu3(e, ALU_AND, s, t, d, lp);
+	} else if (handler == op_or) {
+		jit_alu3(e, ALU_OR, s, t, d, lp);
+	} else if (handler == op_xor) {
+		jit_alu3(e, ALU_XOR, s, t, d, lp);
+	} else if (handler == op_nor) {
+		x86_load(e, EAX, REG(s));
+		x86_alu(e, ALU_OR, EAX, REG(t));
+		x86_not(e, EAX);
+		jit_set_reg(e, d, lp);
+	} else if (handler == op_slt || handler == op_sltu) {
+		x86_load(e, EAX, REG(s));
+		x86_alu(e, ALU_CMP, EAX, REG(t));
+		x86_setcc(e, handler == op_slt ? CC_L : CC_B);
+		jit_set_reg(e, d, lp);
+	} else if (handler == op_sll || handler == op_srl || handler == op_sra) {
+		uint8_t op = handler == op_sll ? SHIFT_SHL : handler == op_srl ? SHIFT_SHR : SHIFT_SAR;
+
+		x86_load(e, EAX, REG(t));
+		x86_shift_imm(e, op, EAX, shift);
+		jit_set_reg(e, d, lp);
+	} else if (handler == op_sllv || handler == op_srlv || handler == op_srav) {
+		uint8_t op = handler == op_sllv ? SHIFT_SHL : handler == op_srlv ? SHIFT_SHR : SHIFT_SAR;
+
+		x86_load(e, ECX, REG(s));
+		x86_load(e, EAX, REG(t));
+		x86_shift_cl(e, op, EAX);
+		jit_set_reg(e, d, lp);
+	} else if (handler == op_addiu) {
+		jit_alu_imm(e, ALU_ADD, s, imm_se, t, lp);
+	} else if (handler == op_andi) {
+		jit_alu_imm(e, ALU_AND, s, imm, t, lp);
+	} else if (handler == op_ori) {
+		jit_alu_imm(e, ALU_OR, s, imm, t, lp);
+	} else if (handler == op_xori) {
+		jit_alu_imm(e, ALU_XOR, s, imm, t, lp);
+	} else if (handler == op_slti || handler == op_sltiu) {
+		x86_load(e, EAX, REG(s));
+		x86_alu_imm(e, ALU_CMP, EAX, imm_se);
+		x86_setcc(e, handler == op_slti ? CC_L : CC_B);
+		jit_set_reg(e, t, lp);
+	} else if (handler == op_lui) {
+		x86_mov_imm(e, EAX, imm << 16);
+		jit_set_reg(e, t, lp);
+	} else if (handler == op_mfhi || handler == op_mflo) {
+		// muldiv_wait: cycles = max(cycles, muldiv_ready)
+		x86_load64(e, EAX, CPU_OFF(muldiv_ready));
+		x86_alu64(e, ALU_CMP, EAX, CPU_OFF(cycles));
+		uint32_t ready = x86_jcc(e, CC_BE);
+		x86_store64(e, CPU_OFF(cycles), EAX);
+		x86_patch(e, ready);
+
+		x86_load(e, EAX, handler == op_mfhi ? CPU_OFF(hi) : CPU_OFF(lo));
+		jit_set_reg(e, d, lp);
+	} else if (handler == op_mthi || handler == op_mtlo) {
+		x86_load(e, EAX, REG(s));
+		x86_store(e, handler == op_mthi ? CPU_OFF(hi) : CPU_OFF(lo), EAX);
+	} else if (handler == op_beq || handler == op_bne) {
+		x86_load(e, EAX, REG(s));
+		x86_alu(e, ALU_CMP, EAX, REG(t));
+		uint32_t skip = x86_jcc(e, handler == op_beq ? CC_NE : CC_E);
+		jit_branch_taken(e, instr->target);
+		x86_patch(e, skip);
+	} else if (handler == op_blez || handler == op_bgtz || handler == op_bltz || handler == op_bgez) {
+		uint8_t cc = handler == op_blez ? CC_G : handler == op_bgtz ? CC_LE : handler == op_bltz ? CC_GE : CC_L;
+
+		x86_load(e, EDX, REG(s));
+		jit_branch_zero(e, cc, instr->target);
+	} else if (handler == op_bltzal || handler == op_bgezal) {
+		x86_load(e, EDX, REG(s));
+		x86_load(e, EAX, CPU_OFF(next_pc));
+		jit_set_reg(e, 31, lp);
+		jit_branch_zero(e, handler == op_bltzal ? CC_GE : CC_L, instr->target);
+	} else if (handler == op_j) {
+		jit_branch_taken(e, instr->target);
+	} else if (handler == op_jal) {
+		x86_load(e, EAX, CPU_OFF(next_pc));
+		jit_set_reg(e, 31, lp);
+		jit_branch_taken(e, instr->target);
+	} else if (handler == op_jr) {
+		x86_load(e, EAX, REG(s));
+		x86_store(e, CPU_OFF(next_pc), EAX);
+		x86_store8_imm(e, CPU_OFF(branch), 1);
+	} else if (handler == op_jalr) {
+		x86_load(e, EDX, REG(s));
+		x86_load(e, EAX, CPU_OFF(next_pc));
+		jit_set_reg(e, d, lp);
+		x86_store(e, CPU_OFF(next_pc), EDX);
+		x86_store8_imm(e, CPU_OFF(branch), 1);
+	} else {
+		x86_call_args(e, OP_OFF(i, instr));
+		x86_call_block(e, OP_OFF(i, handler));
+		return 0;
+	}
+
+	return 1;
+}
+
+// Loads and stores through the window, for RAM and BIOS. Anything the handler
+// would do differently (isolated cache, misaligned, a fault, a store to code)
+// jumps to the slow path, which runs the handler on the untouched state.
+// Returns 0 for any other op.
+char jit_emit_fastmem(Emitter* e, JitSlowPath* slow, OpHandler handler, Decoded* instr) {
+	uint32_t s = instr->s;
+	uint32_t t = instr->t;
+	uint32_t w; // log2 of the width
+	uint8_t ext = 0;
+	char store = 0;
+
+	if (handler == op_lw) {
+		w = 2;
+	} else if (handler == op_lh || handler == op_lhu) {
+		w = 1;
+		ext = handler == op_lh ? MOVSX16 : MOVZX16;
+	} else if (handler == op_lb || handler == op_lbu) {
+		w = 0;
+		ext = handler == op_lb ? MOVSX8 : MOVZX8;
+	} else if (handler == op_sw || handler == op_sh || handler == op_sb) {
+		w = handler == op_sw ? 2 : handler == op_sh ? 1 : 0;
+		store = 1;
+	} else {
+		return 0;
+	}
+
+	slow->count = 0;
+
+	if (store == 1) {
+		x86_test_mem8_imm(e, CPU_OFF(sr) + 2, 0x1);
+		slow->jumps[slow->count++] = x86_jcc(e, CC_NE);
+	}
+
+	x86_load(e, EAX, REG(s));
+	x86_alu_imm(e, ALU_ADD, EAX, instr->imm_se);
+
+	if (w > 0) {
+		x86_test_imm(e, EAX, (1 << w) - 1);
+		slow->jumps[slow->count++] = x86_jcc(e, CC_NE);
+	}
+
+	if (store == 1) {
+		x86_load(e, ECX, REG(t));
+	}
+
+	slow->jumps[slow->count++] = x86_fastmem_site(e);
+
+	if (store == 0) {
+		if (w == 2) {
+			x86_window_load(e, ECX);
+		} else {
+			x86_window_load_ext(e, ext, ECX);
+		}
+
+		x86_store(e, CPU_OFF(next_load[1]), ECX);
+		x86_store_imm(e, CPU_OFF(next_load[0]), t);
+
+		// it didn't fault, so it read RAM or BIOS, only BIOS has bit 28 set
+		x86_add_mem64_imm8(e, CPU_OFF(cycles), LOAD_CYCLES[w][REGION_RAM]);
+		x86_test_imm(e, EAX, 0x10000000);
+		uint32_t ram = x86_jcc(e, CC_E);
+		x86_add_mem64_imm8(e, CPU_OFF(cycles), LOAD_CYCLES[w][REGION_BIOS] - LOAD_CYCLES[w][REGION_RAM]);
+		x86_patch(e, ram);
+	} else {
+		if (w == 2) {
+			x86_window_store(e, ECX);
+		} else if (w == 1) {
+			x86_window_store16(e, ECX);
+		} else {
+			x86_window_store8(e, ECX);
+		}
+
+		// only RAM is writable
+		if (STORE_CYCLES[w][REGION_RAM] != 0) {
+			x86_add_mem64_imm8(e, CPU_OFF(cycles), STORE_CYCLES[w][REGION_RAM]);
+		}
+
+		// a page holding code has to be invalidated, the handler stores the
+		// same value again and does that
+		x86_mov(e, EDX, EAX);
+		x86_alu_imm(e, ALU_AND, EDX, RAM_SIZE - 1);
+		x86_shift_imm(e, SHIFT_SHR, EDX, BLOCK_PAGE_SHIFT);
+		x86_load64(e, ECX, CPU_OFF(cache));
+		x86_bt_ptr(e, ECX, (uint32_t)offsetof(BlockCache, code), EDX);
+		slow->jumps[slow->count++] = x86_jcc(e, CC_B);
+	}
+
+	slow->done = e->len;
+
+	return 1;
+}
+
+void jit_compile(Jit* jit, BlockCache* cache, Block* b) {
+	if (jit->used + b->len * JIT_MAX_OP_SIZE + 64 > JIT_CACHE_SIZE) {
+		jit_flush(jit, cache);
+	}
+
+	Emitter emitter = { jit->code + jit->used, 0 };
+	Emitter* e = &emitter;
+
+	uint32_t exits[BLOCK_MAX_OPS * 2];
+	uint32_t exit_count = 0;
+	JitSlowPath slow[BLOCK_MAX_OPS];
+	uint32_t slow_count = 0;
+
+	x86_prologue(e);
+
+	if (jit->fastmem == 1) {
+		x86_load_window(e, CPU_OFF(intr), (uint32_t)offsetof(Interconnect, fastmem));
+	}
+
+	// a load may be pending on entry and after any handler call, never after
+	// a translated op
+	char lp = 1;
+
+	for (int i = 0; i < b->len; ++i) {
+		BlockOp* op = &b->ops[i];
+
+		if (op->instr.icache == 1) {
+			jit_icache_fetch(e, &op->instr, i);
+		}
+
+		x86_add_mem64_imm8(e, CPU_OFF(cycles), op->instr.cycles);
+
+		if (jit->count_ops == 1) {
+			x86_add_mem64_imm8(e, CPU_OFF(block_ops), 1);
+		}
+
+		// curr_pc = pc; pc = next_pc; next_pc += 4
+		x86_load(e, EAX, CPU_OFF(pc));
+		x86_store(e, CPU_OFF(curr_pc), EAX);
+		x86_load(e, ECX, CPU_OFF(next_pc));
+		x86_store(e, CPU_OFF(pc), ECX);
+		x86_alu_imm(e, ALU_ADD, ECX, 4);
+		x86_store(e, CPU_OFF(next_pc), ECX);
+
+		// delay_slot = branch; branch = 0
+		x86_load8(e, EAX, CPU_OFF(branch));
+		x86_store8(e, CPU_OFF(delay_slot), EAX);
+		x86_store8_imm(e, CPU_OFF(branch), 0);
+
+		char native;
+
+		if (jit->fastmem == 1 && jit_emit_fastmem(e, &slow[slow_count], op->handler, &op->instr) == 1) {
+			// the slow path may have called the handler
+			slow[slow_count++].op = i;
+			native = 0;
+		} else {
+			native = jit_emit_op(e, op->handler, &op->instr, i, lp);
+		}
+
+		if (lp == 1) {
+			// retire_load: regs[load[0]] = load[1]; regs[0] = 0
+			x86_load(e, EAX, CPU_OFF(load[0]));
+			x86_load(e, ECX, CPU_OFF(load[1]));
+			x86_store_indexed(e, REG(0), ECX);
+			x86_store_imm(e, REG(0), 0);
+		}
+
+		if (native == 1) {
+			if (lp == 1) {
+				x86_store_imm64(e, CPU_OFF(load[0]), 0);
+			}
+		} else {
+			// load = next_load; next_load = 0
+			x86_load64(e, EAX, CPU_OFF(next_load[0]));
+			x86_store64(e, CPU_OFF(load[0]), EAX);
+			x86_store_imm64(e, CPU_OFF(next_load[0]), 0);
+		}
+
+		lp = !native;
+
+		if (native == 0 && i != b->len - 1) {
+			// exception taken, or we just overwrote our own code
+			x86_load(e, EAX, CPU_OFF(curr_pc));
+			x86_alu_imm(e, ALU_ADD, EAX, 4);
+			x86_alu(e, ALU_CMP, EAX, CPU_OFF(pc));
+			exits[exit_count++] = x86_jcc(e, CC_NE);
+
+			x86_load64(e, ECX, CPU_OFF(cache));
+			x86_cmp_byte_ptr(e, ECX, (uint32_t)offsetof(BlockCache, dirty));
+			exits[exit_count++] = x86_jcc(e, CC_NE);
+		}
+	}
+
+	for (int i = 0; i < exit_count; ++i) {
+		x86_patch(e, exits[i]);
+	}
+
+	x86_epilogue(e);
+
+	for (int i = 0; i < slow_count; ++i) {
+		for (int j = 0; j < slow[i].count; ++j) {
+			x86_patch(e, slow[i].jumps[j]);
+		}
+
+		x86_call_args(e, OP_OFF(slow[i].op, instr));
+		x86_call_block(e, OP_OFF(slow[i].op, handler));
+		x86_jmp(e, slow[i].done);
+	}
+
+	b->code = jit->code + jit->used;
+	b->code_size = e->len;
+	jit->used += e->len;
+
+	if (jit->perf != NULL) {
+		jit_perf_block(jit->perf, b->vaddr, b->code, e->len);
+	}
+}
+
+// copies code compiled by an earlier run for the same block, see blockfile.h
+void jit_load(Jit* jit, BlockCache* cache, Block* b, uint8_t* code, uint32_t size) {
+	if (jit->used + size > JIT_CACHE_SIZE) {
+		jit_flush(jit, cache);
+	}
+
+	memcpy(jit->code + jit->used, code, size);
+
+	b->code = jit->code + jit->used;
+	b->code_size = size;
+	jit->used += size;
+
+	if (jit->perf != NULL) {
+		jit_perf_block(jit->perf, b->vaddr, b->code, size);
+	}
+}
+
+void run_next_jit_block(Cpu* cpu) {
+	if (cpu->pc % 4 != 0 || cpu_fetch_hooked(cpu) == 1) {
+		return run_next_instruction(cpu);
+	}
+
+	Block* b = block_cache_lookup(cpu->cache, cpu);
+
+	if (b == NULL) {
+		return run_next_instruction(cpu);
+	}
+
+	if (b->code == NULL) {
+		jit_compile(cpu->jit, cpu->cache, b);
+	}
+
+	((JitBlock)b->code)(cpu, b);
+
+	cpu->cache->dirty = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+
+#include "../block.h"
+#include "x86.h"
+#include "perf.h"
+
+#define JIT_CACHE_SIZE ((uint32_t)(32 * 1024 * 1024))
+// worst case host bytes for a single guest instruction
+#define JIT_MAX_OP_SIZE 512
+
+typedef void (*JitBlock)(Cpu* cpu, Block* b);
+
+typedef struct Jit {
+    uint8_t* code;
+    uint32_t used;
+
+    JitPerf* perf; // NULL unless --perf-map or --jitdump asked for it
+    char count_ops; // keep cpu->block_ops up to date, only --bench reads it
+    OpHandler icache_fetch; // cpu_icache_fetch, the code calls it through here
+    char fastmem; // loads and stores go through intr->fastmem, see fastmem.h
+} Jit;
+
+Jit* initialize_jit();
+void jit_flush(Jit* jit, BlockCache* cache);
+void jit_compile(Jit* jit, BlockCache* cache, Block* b);
+void jit_load(Jit* jit, BlockCache* cache, Block* b, uint8_t* code, uint32_t size);
+char jit_emit_op(Emitter* e, OpHandler handler, Decoded* instr, uint32_t i, char load_pending);
+void run_next_jit_block(Cpu* cpu);
+
+#endif
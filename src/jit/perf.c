@@ -0,0 +1,87 @@
+#include "perf.h"
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// perf orders jitdump records against samples with the monotonic clock
+uint64_t jit_perf_timestamp() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+JitPerf* initialize_jit_perf(char map, char dump) {
+	JitPerf* perf = malloc(sizeof(JitPerf));
+	char path[64];
+
+	perf->map = NULL;
+	perf->dump = NULL;
+	perf->index = 0;
+
+	if (map == 1) {
+		snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+		perf->map = fopen(path, "w");
+
+		if (perf->map == NULL) {
+			printf("failed to open perf map %s\n", path);
+			exit(1);
+		}
+	}
+
+	if (dump == 1) {
+		snprintf(path, sizeof(path), "/tmp/jit-%d.dump", (int)getpid());
+		perf->dump = fopen(path, "w+");
+
+		if (perf->dump == NULL) {
+			printf("failed to open jitdump %s\n", path);
+			exit(1);
+		}
+
+		JitDumpHeader h = {
+			JITDUMP_MAGIC, JITDUMP_VERSION, sizeof(JitDumpHeader), JITDUMP_ELF_MACH,
+			0, (uint32_t)getpid(), jit_perf_timestamp(), 0,
+		};
+
+		fwrite(&h, sizeof(h), 1, perf->dump);
+		fflush(perf->dump);
+
+		// perf record only picks the file up from an executable mapping of it
+		void* marker = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE,
+				    fileno(perf->dump), 0);
+
+		if (marker == MAP_FAILED) {
+			printf("failed to map jitdump %s\n", path);
+			exit(1);
+		}
+	}
+
+	return perf;
+}
+
+// both files are flushed per block so a killed emulator still leaves them usable
+void jit_perf_block(JitPerf* perf, uint32_t vaddr, uint8_t* code, uint32_t size) {
+	char name[32];
+	snprintf(name, sizeof(name), "guest_%08x", vaddr);
+
+	if (perf->map != NULL) {
+		fprintf(perf->map, "%llx %x %s\n", (unsigned long long)(uintptr_t)code, size, name);
+		fflush(perf->map);
+	}
+
+	if (perf->dump != NULL) {
+		uint32_t name_size = strlen(name) + 1;
+
+		JitDumpLoad r = {
+			JITDUMP_CODE_LOAD, sizeof(JitDumpLoad) + name_size + size, jit_perf_timestamp(),
+			(uint32_t)getpid(), (uint32_t)getpid(),
+			(uint64_t)(uintptr_t)code, (uint64_t)(uintptr_t)code, size, perf->index++,
+		};
+
+		fwrite(&r, sizeof(r), 1, perf->dump);
+		fwrite(name, name_size, 1, perf->dump);
+		fwrite(code, size, 1, perf->dump);
+		fflush(perf->dump);
+	}
+}
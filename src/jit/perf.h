@@ -0,0 +1,49 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define JITDUMP_MAGIC 0x4a695444
+#define JITDUMP_VERSION 1
+#define JITDUMP_CODE_LOAD 0
+#define JITDUMP_ELF_MACH 62 // EM_X86_64
+
+// Tells perf what the generated code is. /tmp/perf-<pid>.map only names the
+// blocks, /tmp/jit-<pid>.dump also carries the code so perf inject can turn
+// it into something perf annotate disassembles. Blocks compiled again after
+// a flush are simply listed again at the same address.
+typedef struct {
+    FILE* map; // NULL when not written
+    FILE* dump; // NULL when not written
+    uint64_t index; // code_index of the next load record
+} JitPerf;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+} JitDumpHeader;
+
+// followed by the nul terminated name and the code
+typedef struct {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+} JitDumpLoad;
+
+JitPerf* initialize_jit_perf(char map, char dump);
+void jit_perf_block(JitPerf* perf, uint32_t vaddr, uint8_t* code, uint32_t size);
+
+#endif
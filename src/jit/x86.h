@@ -0,0 +1,383 @@
+#ifndef X86_H
+#define X86_H
+
+#include <stdint.h>
+
+// Minimal x86-64 encoder. Guest state is always addressed as [rbx + disp32],
+// the block being run as [r12 + disp32] and the fastmem window as
+// [r13 + rax], eax/ecx/edx are scratch.
+
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define EBX 3
+
+#define ALU_ADD 0
+#define ALU_OR 1
+#define ALU_AND 4
+#define ALU_SUB 5
+#define ALU_XOR 6
+#define ALU_CMP 7
+
+#define SHIFT_SHL 4
+#define SHIFT_SHR 5
+#define SHIFT_SAR 7
+
+#define MOVZX8 0xb6
+#define MOVZX16 0xb7
+#define MOVSX8 0xbe
+#define MOVSX16 0xbf
+
+#define CC_B 0x2
+#define CC_BE 0x6
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xc
+#define CC_GE 0xd
+#define CC_LE 0xe
+#define CC_G 0xf
+
+typedef struct {
+    uint8_t* code;
+    uint32_t len;
+} Emitter;
+
+void x86_byte(Emitter* e, uint8_t b) {
+    e->code[e->len++] = b;
+}
+
+void x86_dword(Emitter* e, uint32_t v) {
+    x86_byte(e, v);
+    x86_byte(e, v >> 8);
+    x86_byte(e, v >> 16);
+    x86_byte(e, v >> 24);
+}
+
+// modrm for [rbx + disp32]
+void x86_mem(Emitter* e, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0x80 | (reg << 3) | EBX);
+    x86_dword(e, disp);
+}
+
+// mov r32, [rbx + disp]
+void x86_load(Emitter* e, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0x8b);
+    x86_mem(e, reg, disp);
+}
+
+// mov [rbx + disp], r32
+void x86_store(Emitter* e, uint32_t disp, uint8_t reg) {
+    x86_byte(e, 0x89);
+    x86_mem(e, reg, disp);
+}
+
+// mov r64, [rbx + disp]
+void x86_load64(Emitter* e, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0x48);
+    x86_load(e, reg, disp);
+}
+
+// mov [rbx + disp], r64
+void x86_store64(Emitter* e, uint32_t disp, uint8_t reg) {
+    x86_byte(e, 0x48);
+    x86_store(e, disp, reg);
+}
+
+// mov r32, imm32
+void x86_mov_imm(Emitter* e, uint8_t reg, uint32_t imm) {
+    x86_byte(e, 0xb8 | reg);
+    x86_dword(e, imm);
+}
+
+// mov dword [rbx + disp], imm32
+void x86_store_imm(Emitter* e, uint32_t disp, uint32_t imm) {
+    x86_byte(e, 0xc7);
+    x86_mem(e, 0, disp);
+    x86_dword(e, imm);
+}
+
+// mov qword [rbx + disp], imm32 (sign extended)
+void x86_store_imm64(Emitter* e, uint32_t disp, uint32_t imm) {
+    x86_byte(e, 0x48);
+    x86_store_imm(e, disp, imm);
+}
+
+// mov byte [rbx + disp], imm8
+void x86_store8_imm(Emitter* e, uint32_t disp, uint8_t imm) {
+    x86_byte(e, 0xc6);
+    x86_mem(e, 0, disp);
+    x86_byte(e, imm);
+}
+
+// mov [rbx + disp], r8
+void x86_store8(Emitter* e, uint32_t disp, uint8_t reg) {
+    x86_byte(e, 0x88);
+    x86_mem(e, reg, disp);
+}
+
+// movzx r32, byte [rbx + disp]
+void x86_load8(Emitter* e, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0x0f);
+    x86_byte(e, 0xb6);
+    x86_mem(e, reg, disp);
+}
+
+// mov [rbx + rax * 4 + disp], r32
+void x86_store_indexed(Emitter* e, uint32_t disp, uint8_t reg) {
+    x86_byte(e, 0x89);
+    x86_byte(e, 0x84 | (reg << 3));
+    x86_byte(e, 0x83);
+    x86_dword(e, disp);
+}
+
+// mov dst, src
+void x86_mov(Emitter* e, uint8_t dst, uint8_t src) {
+    x86_byte(e, 0x89);
+    x86_byte(e, 0xc0 | (src << 3) | dst);
+}
+
+// <op> r32, [rbx + disp]
+void x86_alu(Emitter* e, uint8_t op, uint8_t reg, uint32_t disp) {
+    x86_byte(e, (op << 3) | 0x3);
+    x86_mem(e, reg, disp);
+}
+
+// <op> r64, [rbx + disp]
+void x86_alu64(Emitter* e, uint8_t op, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0x48);
+    x86_alu(e, op, reg, disp);
+}
+
+// <op> r32, imm32
+void x86_alu_imm(Emitter* e, uint8_t op, uint8_t reg, uint32_t imm) {
+    x86_byte(e, 0x81);
+    x86_byte(e, 0xc0 | (op << 3) | reg);
+    x86_dword(e, imm);
+}
+
+// test r32, imm32
+void x86_test_imm(Emitter* e, uint8_t reg, uint32_t imm) {
+    x86_byte(e, 0xf7);
+    x86_byte(e, 0xc0 | reg);
+    x86_dword(e, imm);
+}
+
+// cmp dword [rbx + disp], imm8
+void x86_cmp_mem_imm8(Emitter* e, uint32_t disp, int8_t imm) {
+    x86_byte(e, 0x83);
+    x86_mem(e, ALU_CMP, disp);
+    x86_byte(e, imm);
+}
+
+// cmp dword [rbx + disp], imm32
+void x86_cmp_mem_imm(Emitter* e, uint32_t disp, uint32_t imm) {
+    x86_byte(e, 0x81);
+    x86_mem(e, ALU_CMP, disp);
+    x86_dword(e, imm);
+}
+
+// test byte [rbx + disp], imm8
+void x86_test_mem8_imm(Emitter* e, uint32_t disp, uint8_t imm) {
+    x86_byte(e, 0xf6);
+    x86_mem(e, 0, disp);
+    x86_byte(e, imm);
+}
+
+// add qword [rbx + disp], imm8
+void x86_add_mem64_imm8(Emitter* e, uint32_t disp, int8_t imm) {
+    x86_byte(e, 0x48);
+    x86_byte(e, 0x83);
+    x86_mem(e, ALU_ADD, disp);
+    x86_byte(e, imm);
+}
+
+// not r32
+void x86_not(Emitter* e, uint8_t reg) {
+    x86_byte(e, 0xf7);
+    x86_byte(e, 0xd0 | reg);
+}
+
+// <shift> r32, imm8
+void x86_shift_imm(Emitter* e, uint8_t op, uint8_t reg, uint8_t imm) {
+    x86_byte(e, 0xc1);
+    x86_byte(e, 0xc0 | (op << 3) | reg);
+    x86_byte(e, imm);
+}
+
+// <shift> r32, cl
+void x86_shift_cl(Emitter* e, uint8_t op, uint8_t reg) {
+    x86_byte(e, 0xd3);
+    x86_byte(e, 0xc0 | (op << 3) | reg);
+}
+
+// set<cc> al; movzx eax, al
+void x86_setcc(Emitter* e, uint8_t cc) {
+    x86_byte(e, 0x0f);
+    x86_byte(e, 0x90 | cc);
+    x86_byte(e, 0xc0);
+    x86_byte(e, 0x0f);
+    x86_byte(e, 0xb6);
+    x86_byte(e, 0xc0);
+}
+
+// j<cc> rel32, returns the offset of the displacement for patching
+uint32_t x86_jcc(Emitter* e, uint8_t cc) {
+    x86_byte(e, 0x0f);
+    x86_byte(e, 0x80 | cc);
+    x86_dword(e, 0);
+    return e->len - 4;
+}
+
+// jmp rel32 back to an offset emitted earlier
+void x86_jmp(Emitter* e, uint32_t to) {
+    x86_byte(e, 0xe9);
+    x86_dword(e, to - (e->len + 4));
+}
+
+// point a jump emitted earlier at the current position
+void x86_patch(Emitter* e, uint32_t at) {
+    uint32_t rel = e->len - (at + 4);
+
+    e->code[at + 0] = rel;
+    e->code[at + 1] = rel >> 8;
+    e->code[at + 2] = rel >> 16;
+    e->code[at + 3] = rel >> 24;
+}
+
+// handler(cpu, arg): rdi = rbx, rsi = arg
+// mov rdi, rbx; lea rsi, [r12 + arg]: the cpu and something in the block
+void x86_call_args(Emitter* e, uint32_t arg) {
+    x86_byte(e, 0x48); // mov rdi, rbx
+    x86_byte(e, 0x89);
+    x86_byte(e, 0xdf);
+    x86_byte(e, 0x49); // lea rsi, [r12 + disp32]
+    x86_byte(e, 0x8d);
+    x86_byte(e, 0xb4);
+    x86_byte(e, 0x24);
+    x86_dword(e, arg);
+}
+
+// call [r12 + disp], a function pointer stored in the block
+void x86_call_block(Emitter* e, uint32_t disp) {
+    x86_byte(e, 0x41);
+    x86_byte(e, 0xff);
+    x86_byte(e, 0x94);
+    x86_byte(e, 0x24);
+    x86_dword(e, disp);
+}
+
+// call [reg + disp]
+void x86_call_ptr(Emitter* e, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0xff);
+    x86_byte(e, 0x90 | reg);
+    x86_dword(e, disp);
+}
+
+// cmp byte [reg + disp], 0
+void x86_cmp_byte_ptr(Emitter* e, uint8_t reg, uint32_t disp) {
+    x86_byte(e, 0x80);
+    x86_byte(e, 0xb8 | reg);
+    x86_dword(e, disp);
+    x86_byte(e, 0x00);
+}
+
+// bt dword [reg + disp], bit
+void x86_bt_ptr(Emitter* e, uint8_t reg, uint32_t disp, uint8_t bit) {
+    x86_byte(e, 0x0f);
+    x86_byte(e, 0xa3);
+    x86_byte(e, 0x80 | (bit << 3) | reg);
+    x86_dword(e, disp);
+}
+
+// mov r13, [rbx + disp]; mov r13, [r13 + field]: the window base, through a
+// pointer in the guest state
+void x86_load_window(Emitter* e, uint32_t disp, uint32_t field) {
+    x86_byte(e, 0x4c);
+    x86_byte(e, 0x8b);
+    x86_byte(e, 0xab);
+    x86_dword(e, disp);
+    x86_byte(e, 0x4d);
+    x86_byte(e, 0x8b);
+    x86_byte(e, 0xad);
+    x86_dword(e, field);
+}
+
+// nop [rax + disp32] in front of a window access, see fastmem.h. Returns the
+// offset of the displacement, which is patched like a jump.
+uint32_t x86_fastmem_site(Emitter* e) {
+    x86_byte(e, 0x0f);
+    x86_byte(e, 0x1f);
+    x86_byte(e, 0x80);
+    x86_dword(e, 0);
+    return e->len - 4;
+}
+
+// modrm for [r13 + rax]
+void x86_window(Emitter* e, uint8_t reg) {
+    x86_byte(e, 0x44 | (reg << 3));
+    x86_byte(e, 0x05);
+    x86_byte(e, 0x00);
+}
+
+// mov r32, [r13 + rax]
+void x86_window_load(Emitter* e, uint8_t reg) {
+    x86_byte(e, 0x41);
+    x86_byte(e, 0x8b);
+    x86_window(e, reg);
+}
+
+// movzx/movsx r32, byte/word [r13 + rax]
+void x86_window_load_ext(Emitter* e, uint8_t op, uint8_t reg) {
+    x86_byte(e, 0x41);
+    x86_byte(e, 0x0f);
+    x86_byte(e, op);
+    x86_window(e, reg);
+}
+
+// mov [r13 + rax], r32
+void x86_window_store(Emitter* e, uint8_t reg) {
+    x86_byte(e, 0x41);
+    x86_byte(e, 0x89);
+    x86_window(e, reg);
+}
+
+// mov [r13 + rax], r16
+void x86_window_store16(Emitter* e, uint8_t reg) {
+    x86_byte(e, 0x66);
+    x86_window_store(e, reg);
+}
+
+// mov [r13 + rax], r8, only for al/cl/dl/bl
+void x86_window_store8(Emitter* e, uint8_t reg) {
+    x86_byte(e, 0x41);
+    x86_byte(e, 0x88);
+    x86_window(e, reg);
+}
+
+// The block being run stays in r12 and the fastmem window, when used, in r13.
+// Everything is reached through those and rbx, so the code holds no host
+// addresses and can be copied anywhere.
+void x86_prologue(Emitter* e) {
+    x86_byte(e, 0x53); // push rbx
+    x86_byte(e, 0x41); // push r12
+    x86_byte(e, 0x54);
+    x86_byte(e, 0x41); // push r13, also keeps calls 16 byte aligned
+    x86_byte(e, 0x55);
+    x86_byte(e, 0x48); // mov rbx, rdi
+    x86_byte(e, 0x89);
+    x86_byte(e, 0xfb);
+    x86_byte(e, 0x49); // mov r12, rsi
+    x86_byte(e, 0x89);
+    x86_byte(e, 0xf4);
+}
+
+void x86_epilogue(Emitter* e) {
+    x86_byte(e, 0x41); // pop r13
+    x86_byte(e, 0x5d);
+    x86_byte(e, 0x41); // pop r12
+    x86_byte(e, 0x5c);
+    x86_byte(e, 0x5b); // pop rbx
+    x86_byte(e, 0xc3); // ret
+}
+
+#endif
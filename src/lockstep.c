@@ -0,0 +1,203 @@
+#include "lockstep.h"
+
+#include "cpu.h"
+#include "interconnect.h"
+#include "dma.h"
+
+// a second machine in the same state, with a headless gpu and its own
+// scheduler. The BIOS is read only and shared.
+Interconnect* lockstep_clone_intr(Interconnect* intr) {
+	Ram* ram = initialize_ram();
+	memcpy(ram->data, intr->ram->data, RAM_SIZE);
+
+	Dma* dma = initialize_dma();
+	dma->control = intr->dma->control;
+	dma->interrupt = intr->dma->interrupt;
+
+	for (int i = 0; i < 7; ++i) {
+		*dma->channels[i] = *intr->dma->channels[i];
+	}
+
+	Interconnect* clone = initialize_interconnect(intr->bios, ram, dma, initialize_headless_gpu(), initialize_scheduler());
+	memcpy(clone->scratchpad, intr->scratchpad, SCRATCHPAD_SIZE);
+
+	return clone;
+}
+
+Cpu* lockstep_clone_cpu(Cpu* cpu, Interconnect* intr) {
+	Cpu* clone = malloc(sizeof(Cpu));
+
+	*clone = *cpu;
+	clone->intr = intr;
+	clone->fetch_tag = FETCH_NONE;
+	clone->mode = CPU_MODE_INTERPRETER;
+	clone->cache = NULL;
+	clone->jit = NULL;
+	clone->profile = NULL;
+	clone->trace = NULL;
+
+	// both sides decode their own memory
+	for (int i = 0; i < MEM_PAGE_COUNT; ++i) {
+		clone->decoded[i] = NULL;
+	}
+
+	if (cpu->hle != NULL) {
+		clone->hle = malloc(sizeof(Hle));
+		*clone->hle = *cpu->hle;
+	}
+
+	if (cpu->exe != NULL) {
+		clone->exe = malloc(sizeof(Exe));
+		*clone->exe = *cpu->exe;
+		clone->exe->text = malloc(cpu->exe->text_size);
+		memcpy(clone->exe->text, cpu->exe->text, cpu->exe->text_size);
+	}
+
+	return clone;
+}
+
+char lockstep_same(Cpu* a, Cpu* b) {
+	return a->pc == b->pc && a->next_pc == b->next_pc && a->cycles == b->cycles
+	       && memcmp(a->regs, b->regs, sizeof(a->regs)) == 0
+	       && a->hi == b->hi && a->lo == b->lo
+	       && a->sr == b->sr && a->cause == b->cause && a->epc == b->epc
+	       && a->load[0] == b->load[0] && a->load[1] == b->load[1]
+	       && a->branch == b->branch
+	       && memcmp(&a->gte, &b->gte, sizeof(Gte)) == 0
+	       && memcmp(&a->icache, &b->icache, sizeof(ICache)) == 0;
+}
+
+uint64_t lockstep_ram_hash(Cpu* cpu) {
+	uint8_t* data = cpu->intr->ram->data;
+	uint64_t h = 0xcbf29ce484222325;
+
+	for (uint32_t i = 0; i < RAM_SIZE; i += 8) {
+		uint64_t v;
+		memcpy(&v, data + i, 8);
+		h = (h ^ v) * 0x100000001b3;
+	}
+
+	return h;
+}
+
+void lockstep_dump(const char* name, Cpu* cpu) {
+	printf("%s: pc %08x next_pc %08x cycles %llu ram %016llx\n", name, cpu->pc, cpu->next_pc,
+	       (unsigned long long)cpu->cycles, (unsigned long long)lockstep_ram_hash(cpu));
+	printf("  sr %08x cause %08x epc %08x hi %08x lo %08x load %u=%08x\n",
+	       cpu->sr, cpu->cause, cpu->epc, cpu->hi, cpu->lo, cpu->load[0], cpu->load[1]);
+
+	for (int i = 0; i < 32; i += 4) {
+		printf("  r%-2d %08x %08x %08x %08x\n", i,
+		       cpu->regs[i], cpu->regs[i + 1], cpu->regs[i + 2], cpu->regs[i + 3]);
+	}
+}
+
+void lockstep_diverged(Lockstep* l, uint32_t pc, const char* what) {
+	printf("lockstep: %s differs after %llu blocks, block at %08x\n",
+	       what, (unsigned long long)l->blocks, pc);
+
+	lockstep_dump("interpreter", l->ref);
+	lockstep_dump(l->test->mode == CPU_MODE_JIT ? "jit" : "cached", l->test);
+
+	exit(1);
+}
+
+void lockstep_compare_ram(Lockstep* l, uint32_t pc) {
+	uint8_t* a = l->ref->intr->ram->data;
+	uint8_t* b = l->test->intr->ram->data;
+
+	if (memcmp(l->ref->intr->scratchpad, l->test->intr->scratchpad, SCRATCHPAD_SIZE) != 0) {
+		lockstep_diverged(l, pc, "scratchpad");
+	}
+
+	if (memcmp(a, b, RAM_SIZE) == 0) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < RAM_SIZE; ++i) {
+		if (a[i] != b[i]) {
+			printf("lockstep: first RAM difference at %08x: %02x %02x\n", i, a[i], b[i]);
+			break;
+		}
+	}
+
+	lockstep_diverged(l, pc, "RAM");
+}
+
+Lockstep* lockstep_exit_summary = NULL;
+
+void lockstep_exit() {
+	printf("lockstep: %llu blocks compared\n", (unsigned long long)lockstep_exit_summary->blocks);
+}
+
+// Runs cpu with the interpreter and a clone of it with the named backend.
+// After every block of the backend the interpreter catches up to the same
+// cycle and both register files must match. Never returns, exits with 1 at
+// the first difference.
+void lockstep_run(Cpu* cpu, const char* mode) {
+	Lockstep* l = malloc(sizeof(Lockstep));
+
+	l->ref = cpu;
+	l->test = lockstep_clone_cpu(cpu, lockstep_clone_intr(cpu->intr));
+	l->blocks = 0;
+
+	l->ref->mode = CPU_MODE_INTERPRETER;
+	l->test->cache = initialize_block_cache();
+	l->test->intr->cache = l->test->cache;
+
+	if (strcmp(mode, "cached") == 0) {
+		l->test->mode = CPU_MODE_CACHED;
+#ifdef __x86_64__
+	} else if (strcmp(mode, "jit") == 0) {
+		l->test->mode = CPU_MODE_JIT;
+		l->test->jit = initialize_jit();
+#endif
+	} else {
+		printf("unknown lockstep backend: %s\n", mode);
+		exit(1);
+	}
+
+	// the jit doesn't skip idle loops, the cycle counts would drift apart
+	l->ref->idle.enabled = 0;
+	l->test->idle.enabled = 0;
+
+	Scheduler* ref_s = l->ref->intr->scheduler;
+	Scheduler* test_s = l->test->intr->scheduler;
+
+	scheduler_add(ref_s, GPU_FRAME_CYCLES, gpu_vblank, l->ref->intr->gpu);
+	scheduler_add(test_s, GPU_FRAME_CYCLES, gpu_vblank, l->test->intr->gpu);
+
+	lockstep_exit_summary = l;
+	atexit(lockstep_exit);
+
+	while (1) {
+		uint32_t pc = l->test->pc;
+
+#ifdef __x86_64__
+		if (l->test->mode == CPU_MODE_JIT) {
+			run_next_jit_block(l->test);
+		} else
+#endif
+		{
+			run_next_block(l->test);
+		}
+
+		for (int i = 0; i < LOCKSTEP_MAX_STEPS && l->ref->cycles < l->test->cycles; ++i) {
+			run_next_instruction(l->ref);
+		}
+
+		l->blocks += 1;
+
+		if (lockstep_same(l->ref, l->test) == 0) {
+			lockstep_diverged(l, pc, "cpu state");
+		}
+
+		if (l->blocks % LOCKSTEP_RAM_INTERVAL == 0) {
+			lockstep_compare_ram(l, pc);
+		}
+
+		// both sides see events at the same instruction
+		scheduler_run(ref_s, l->ref->cycles);
+		scheduler_run(test_s, l->test->cycles);
+	}
+}
@@ -0,0 +1,24 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+
+// RAM is compared every this many blocks, registers after every block
+#define LOCKSTEP_RAM_INTERVAL 1024
+// most interpreter steps needed to catch up with one block
+#define LOCKSTEP_MAX_STEPS (BLOCK_MAX_OPS + 2)
+
+typedef struct Cpu Cpu;
+typedef struct Interconnect Interconnect;
+
+typedef struct {
+    Cpu* ref; // interpreter
+    Cpu* test; // backend under test
+    uint64_t blocks;
+} Lockstep;
+
+Interconnect* lockstep_clone_intr(Interconnect* intr);
+Cpu* lockstep_clone_cpu(Cpu* cpu, Interconnect* intr);
+void lockstep_run(Cpu* cpu, const char* mode);
+
+#endif
@@ -2,14 +2,35 @@
 #include "bios.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include "glad.c"
 
+#include "scheduler.c"
 #include "cpu.c"
+#include "gte.c"
+#include "dispatch.c"
+#include "idle.c"
+#include "breakpoint.c"
+#include "hle.c"
+#include "exe.c"
 #include "interconnect.c"
+#include "fastmem.c"
+#include "timing.c"
+#include "icache.c"
+#include "block.c"
+#include "blockfile.c"
+#include "profile.c"
+#include "trace/trace.c"
+#ifdef __x86_64__
+#include "jit/perf.c"
+#include "jit/jit.c"
+#endif
 #include "dma.c"
 #include "gpu/gpu.c"
 #include "gpu/shader.c"
+#include "bench.c"
+#include "lockstep.c"
 #include "ram.h"
 #include "dma.h"
 
@@ -17,12 +38,156 @@ int main(int argc, char* argv[]) {
 	Bios* bios = initialize_bios("SCPH1001.BIN");
 	Ram* ram = initialize_ram();
 	Dma* dma = initialize_dma();
-	Gpu* gpu = initialize_gpu();
-	Interconnect* intr = initialize_interconnect(bios, ram, dma, gpu);
+	char headless = 0;
+
+	// the window is opened before the rest of the arguments are parsed
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--headless") == 0 || strcmp(argv[i], "--lockstep") == 0) {
+			headless = 1;
+		}
+
+		// needs no machine at all
+		if (strcmp(argv[i], "--bench-gte") == 0 && i + 1 < argc) {
+			bench_gte(strtoull(argv[i + 1], NULL, 10));
+		}
+	}
+
+	Gpu* gpu = headless == 1 ? initialize_headless_gpu() : initialize_gpu();
+	Scheduler* scheduler = initialize_scheduler();
+	Interconnect* intr = initialize_interconnect(bios, ram, dma, gpu, scheduler);
 	Cpu* cpu = initialize_cpu(intr);        
-    
+	uint64_t bench = 0;
+	char fast_boot = 0;
+	const char* lockstep = NULL;
+	const char* block_dir = NULL;
+	char perf_map = 0;
+	char jitdump = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--cached") == 0) {
+			cpu->mode = CPU_MODE_CACHED;
+			cpu->cache = initialize_block_cache();
+			intr->cache = cpu->cache;
+		} else if (strcmp(argv[i], "--jit") == 0) {
+#ifdef __x86_64__
+			cpu->mode = CPU_MODE_JIT;
+			cpu->cache = initialize_block_cache();
+			intr->cache = cpu->cache;
+			cpu->jit = initialize_jit();
+#else
+			printf("the jit is only available on x86-64 hosts\n");
+			exit(1);
+#endif
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			cpu->mode = CPU_MODE_PROFILE;
+			cpu->profile = initialize_profile(argv[++i]);
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			cpu->mode = CPU_MODE_TRACE;
+			cpu->trace = initialize_trace(argv[++i]);
+		} else if (strcmp(argv[i], "--fastmem") == 0) {
+			initialize_fastmem(intr);
+		} else if (strcmp(argv[i], "--dispatch") == 0 && i + 1 < argc) {
+			cpu->dispatch = dispatch_from_name(argv[++i]);
+		} else if (strcmp(argv[i], "--hle") == 0) {
+			if (cpu->hle == NULL) {
+				cpu->hle = initialize_hle();
+			}
+		} else if (strcmp(argv[i], "--lle") == 0 && i + 1 < argc) {
+			if (cpu->hle == NULL) {
+				cpu->hle = initialize_hle();
+			}
+			hle_set_enabled(cpu->hle, argv[++i], 0);
+		} else if (strcmp(argv[i], "--exe") == 0 && i + 1 < argc) {
+			cpu->exe = initialize_exe(argv[++i]);
+		} else if (strcmp(argv[i], "--fast-boot") == 0) {
+			fast_boot = 1;
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			// picked up before the gpu was created
+		} else if (strcmp(argv[i], "--lockstep") == 0 && i + 1 < argc) {
+			lockstep = argv[++i];
+		} else if (strcmp(argv[i], "--no-idle-skip") == 0) {
+			cpu->idle.enabled = 0;
+		} else if (strcmp(argv[i], "--block-cache") == 0 && i + 1 < argc) {
+			block_dir = argv[++i];
+		} else if (strcmp(argv[i], "--perf-map") == 0) {
+			perf_map = 1;
+		} else if (strcmp(argv[i], "--jitdump") == 0) {
+			jitdump = 1;
+		} else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+			bench = strtoull(argv[++i], NULL, 10);
+		} else {
+			printf("unknown argument: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	if (intr->fastmem != NULL) {
+		if (cpu->jit == NULL) {
+			printf("--fastmem needs --jit\n");
+			exit(1);
+		}
+#ifdef __x86_64__
+		cpu->jit->fastmem = 1;
+#endif
+	}
+
+	if (perf_map == 1 || jitdump == 1) {
+		if (cpu->jit == NULL) {
+			printf("--perf-map and --jitdump need --jit\n");
+			exit(1);
+		}
+#ifdef __x86_64__
+		cpu->jit->perf = initialize_jit_perf(perf_map, jitdump);
+#endif
+	}
+
+	if (block_dir != NULL) {
+		if (cpu->cache == NULL) {
+			printf("--block-cache needs --cached or --jit\n");
+			exit(1);
+		}
+
+		BlockFile* blocks = initialize_blockfile(block_dir, cpu);
+		blockfile_load(blocks);
+		blockfile_save_at_exit(blocks);
+	}
+
+	// without --fast-boot the BIOS sets up the kernel first and the exe is
+	// loaded when it reaches the shell
+	if (fast_boot == 1) {
+		if (cpu->exe == NULL) {
+			printf("--fast-boot needs an --exe\n");
+			exit(1);
+		}
+
+		exe_fast_boot(cpu);
+	}
+
+	if (cpu->trace != NULL) {
+		trace_finish_at_exit(cpu->trace);
+	}
+
+	if (cpu->profile != NULL) {
+		profile_report_at_exit(cpu->profile);
+	}
+
+	if (cpu->hle != NULL) {
+		hle_report_at_exit(cpu->hle);
+	}
+
+	if (bench > 0) {
+		bench_run(cpu, bench);
+	}
+
+	if (lockstep != NULL) {
+		lockstep_run(cpu, lockstep);
+	}
+
+	scheduler_add(scheduler, GPU_FRAME_CYCLES, gpu_vblank, gpu);
+
 	while (1) {
-		run_next_instruction(cpu);
+		cpu_run_for(cpu, GPU_FRAME_CYCLES);
+		scheduler_run(scheduler, cpu->cycles);
 	}
 
 	return 0;
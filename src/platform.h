@@ -9,6 +9,7 @@ typedef int16_t int16;
 typedef int32_t int32;
 
 #define BIOS_SIZE ((uint32_t)(524288)) // 512 kB
+#define CPU_CLOCK 33868800 // Hz
 // uint32_t RESET = 0xbfc00000;
 
 #endif
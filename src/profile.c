@@ -0,0 +1,300 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <time.h>
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "cpu.h"
+#include "interconnect.h"
+
+Profile* initialize_profile(const char* path) {
+	Profile* p = malloc(sizeof(Profile));
+
+	p->counts = calloc(PROFILE_SLOTS, sizeof(uint64_t));
+	p->block_counts = calloc(PROFILE_SLOTS, sizeof(uint64_t));
+	p->block_instrs = calloc(PROFILE_SLOTS, sizeof(uint64_t));
+	p->block_ticks = calloc(PROFILE_SLOTS, sizeof(uint64_t));
+
+	ProfileRegion regions[PROFILE_REGION_COUNT] = {
+		{ "scratchpad", SCRATCHPAD },
+		{ "mem_control", MEM_CONTROL },
+		{ "ram_size", RAM_CONF_SIZE },
+		{ "irq", IRQ_CONTROL },
+		{ "dma", DMA },
+		{ "timers", TIMERS },
+		{ "gpu", GPU },
+		{ "spu", SPU_RANGE },
+		{ "expansion_1", EXPANSION_1 },
+		{ "expansion_2", EXPANSION_2 },
+		{ "cache_control", CACHE_CONTROL },
+		{ "other", NULL },
+	};
+
+	for (int i = 0; i < PROFILE_REGION_COUNT; ++i) {
+		p->regions[i] = regions[i];
+	}
+
+	p->leader = PROFILE_OTHER;
+	p->new_block = 1;
+	p->path = path;
+
+	return p;
+}
+
+// host time stamp, cpu cycles where there is a cheap counter
+uint64_t profile_ticks() {
+#ifdef __x86_64__
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+const char* profile_tick_unit() {
+#ifdef __x86_64__
+	return "tsc";
+#else
+	return "ns";
+#endif
+}
+
+uint32_t profile_slot(uint32_t addr) {
+	uint32_t phys = mask_region(addr);
+
+	if (phys < RAM_SIZE) {
+		return phys >> 2;
+	}
+
+	if (range_contains(BIOS_RANGE, phys) == 1 && phys < BIOS_RANGE[0] + BIOS_SIZE) {
+		return RAM_SIZE / 4 + (range_offset(BIOS_RANGE, phys) >> 2);
+	}
+
+	return PROFILE_OTHER;
+}
+
+// the address code at a slot is usually run from
+uint32_t profile_addr(uint32_t slot) {
+	if (slot < RAM_SIZE / 4) {
+		return 0x80000000 | slot << 2;
+	}
+
+	if (slot == PROFILE_OTHER) {
+		return 0xffffffff;
+	}
+
+	return RESET + ((slot - RAM_SIZE / 4) << 2);
+}
+
+// the mmio region the load or store at pc is about to access, NULL for
+// anything else
+ProfileRegion* profile_mmio(Cpu* cpu, Profile* p) {
+	Instruction instr = cpu_peek32(cpu, cpu->pc);
+	uint32_t op = instr_function(instr);
+
+	// lb ... swr, the coprocessor transfers never touch mmio in practice
+	if (op < 0x20 || op > 0x2e) {
+		return NULL;
+	}
+
+	uint32_t addr = mask_region(cpu->regs[instr_s(instr)] + instr_imm_se(instr));
+	MemPage* page = intr_page(cpu->intr, addr);
+
+	if (page != NULL && page->read != NULL) {
+		return NULL;
+	}
+
+	for (int i = 0; i < PROFILE_REGION_COUNT - 1; ++i) {
+		if (range_contains(p->regions[i].range, addr) == 1) {
+			return &p->regions[i];
+		}
+	}
+
+	return &p->regions[PROFILE_REGION_COUNT - 1];
+}
+
+// run_next_instruction with bookkeeping, cpu_run_for calls this instead of
+// the dispatchers so profiling costs nothing when it's off
+void run_profiled(Cpu* cpu) {
+	Profile* p = cpu->profile;
+	uint64_t start = profile_ticks();
+
+	while (cpu->cycles < cpu->deadline) {
+		uint32_t pc = cpu->pc;
+		uint32_t slot = profile_slot(pc);
+
+		if (p->new_block == 1) {
+			p->leader = slot;
+			p->block_counts[slot] += 1;
+		}
+
+		p->counts[slot] += 1;
+		p->block_instrs[p->leader] += 1;
+
+		ProfileRegion* region = profile_mmio(cpu, p);
+
+		run_next_instruction(cpu);
+
+		uint64_t now = profile_ticks();
+		p->block_ticks[p->leader] += now - start;
+
+		if (region != NULL) {
+			region->accesses += 1;
+			region->ticks += now - start;
+		}
+
+		start = now;
+
+		// after a delay slot, or wherever an exception went
+		p->new_block = cpu->delay_slot == 1 || cpu->pc != pc + 4;
+	}
+}
+
+uint64_t* profile_sort_key;
+
+int profile_compare(const void* a, const void* b) {
+	uint64_t ka = profile_sort_key[*(const uint32_t*)a];
+	uint64_t kb = profile_sort_key[*(const uint32_t*)b];
+
+	return ka < kb ? 1 : ka > kb ? -1 : 0;
+}
+
+// slots with a non zero key, highest first
+uint32_t* profile_sorted(uint64_t* key, uint32_t* len) {
+	uint32_t* slots = malloc(PROFILE_SLOTS * sizeof(uint32_t));
+	uint32_t n = 0;
+
+	for (uint32_t i = 0; i < PROFILE_SLOTS; ++i) {
+		if (key[i] != 0) {
+			slots[n++] = i;
+		}
+	}
+
+	profile_sort_key = key;
+	qsort(slots, n, sizeof(uint32_t), profile_compare);
+
+	*len = n;
+	return slots;
+}
+
+uint64_t profile_sum(uint64_t* values) {
+	uint64_t sum = 0;
+
+	for (uint32_t i = 0; i < PROFILE_SLOTS; ++i) {
+		sum += values[i];
+	}
+
+	return sum;
+}
+
+void profile_report(Profile* p) {
+	uint64_t instructions = profile_sum(p->counts);
+	uint64_t ticks = profile_sum(p->block_ticks);
+	uint32_t len;
+
+	if (instructions == 0) {
+		return;
+	}
+
+	printf("profile: %llu instructions, %llu %s\n",
+	       (unsigned long long)instructions, (unsigned long long)ticks, profile_tick_unit());
+
+	uint32_t* blocks = profile_sorted(p->block_instrs, &len);
+
+	printf("profile: hot blocks      runs instructions      %%     %s\n", profile_tick_unit());
+	for (uint32_t i = 0; i < len && i < PROFILE_REPORT_TOP; ++i) {
+		uint32_t s = blocks[i];
+
+		printf("profile: %08x %10llu %12llu %6.2f %12llu\n", profile_addr(s),
+		       (unsigned long long)p->block_counts[s], (unsigned long long)p->block_instrs[s],
+		       100.0 * p->block_instrs[s] / instructions, (unsigned long long)p->block_ticks[s]);
+	}
+	free(blocks);
+
+	uint32_t* pcs = profile_sorted(p->counts, &len);
+
+	printf("profile: hot instructions  executions      %%\n");
+	for (uint32_t i = 0; i < len && i < PROFILE_REPORT_TOP; ++i) {
+		uint32_t s = pcs[i];
+
+		printf("profile: %08x %18llu %6.2f\n", profile_addr(s),
+		       (unsigned long long)p->counts[s], 100.0 * p->counts[s] / instructions);
+	}
+	free(pcs);
+
+	printf("profile: mmio            accesses   %s\n", profile_tick_unit());
+	for (int i = 0; i < PROFILE_REGION_COUNT; ++i) {
+		ProfileRegion* r = &p->regions[i];
+
+		if (r->accesses > 0) {
+			printf("profile: %-14s %10llu %12llu\n", r->name,
+			       (unsigned long long)r->accesses, (unsigned long long)r->ticks);
+		}
+	}
+}
+
+// everything in JSON, blocks and instructions sorted hottest first
+void profile_write(Profile* p) {
+	FILE* f = fopen(p->path, "w");
+
+	if (f == NULL) {
+		printf("can't write profile: %s\n", p->path);
+		return;
+	}
+
+	uint32_t len;
+
+	fprintf(f, "{\n\"tick_unit\": \"%s\",\n", profile_tick_unit());
+	fprintf(f, "\"instructions\": %llu,\n", (unsigned long long)profile_sum(p->counts));
+
+	uint32_t* blocks = profile_sorted(p->block_instrs, &len);
+
+	fprintf(f, "\"blocks\": [");
+	for (uint32_t i = 0; i < len; ++i) {
+		uint32_t s = blocks[i];
+
+		fprintf(f, "%s\n  {\"addr\": %u, \"runs\": %llu, \"instructions\": %llu, \"ticks\": %llu}",
+		        i == 0 ? "" : ",", profile_addr(s), (unsigned long long)p->block_counts[s],
+		        (unsigned long long)p->block_instrs[s], (unsigned long long)p->block_ticks[s]);
+	}
+	fprintf(f, "\n],\n");
+	free(blocks);
+
+	uint32_t* pcs = profile_sorted(p->counts, &len);
+
+	fprintf(f, "\"pcs\": [");
+	for (uint32_t i = 0; i < len; ++i) {
+		fprintf(f, "%s\n  {\"addr\": %u, \"executions\": %llu}", i == 0 ? "" : ",",
+		        profile_addr(pcs[i]), (unsigned long long)p->counts[pcs[i]]);
+	}
+	fprintf(f, "\n],\n");
+	free(pcs);
+
+	fprintf(f, "\"mmio\": [");
+	for (int i = 0; i < PROFILE_REGION_COUNT; ++i) {
+		ProfileRegion* r = &p->regions[i];
+
+		fprintf(f, "%s\n  {\"region\": \"%s\", \"accesses\": %llu, \"ticks\": %llu}",
+		        i == 0 ? "" : ",", r->name, (unsigned long long)r->accesses,
+		        (unsigned long long)r->ticks);
+	}
+	fprintf(f, "\n]\n}\n");
+
+	fclose(f);
+}
+
+Profile* profile_exit_report = NULL;
+
+void profile_exit() {
+	profile_report(profile_exit_report);
+	profile_write(profile_exit_report);
+}
+
+void profile_report_at_exit(Profile* p) {
+	profile_exit_report = p;
+	atexit(profile_exit);
+}
@@ -0,0 +1,47 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#include "ram.h"
+#include "platform.h"
+
+// one counter per instruction word of RAM and BIOS, the last slot takes
+// everything else
+#define PROFILE_SLOTS (RAM_SIZE / 4 + BIOS_SIZE / 4 + 1)
+#define PROFILE_OTHER (PROFILE_SLOTS - 1)
+#define PROFILE_REGION_COUNT 12
+// entries printed per table in the text report
+#define PROFILE_REPORT_TOP 20
+
+typedef struct Cpu Cpu;
+
+typedef struct {
+    const char* name;
+    uint32_t* range; // NULL for anything not covered by the other regions
+    uint64_t accesses;
+    uint64_t ticks; // host time of the instructions that accessed it
+} ProfileRegion;
+
+typedef struct Profile {
+    uint64_t* counts; // executions per instruction
+    uint64_t* block_counts; // times a basic block started at the instruction
+    uint64_t* block_instrs; // instructions executed in the block
+    uint64_t* block_ticks; // host time spent in the block
+
+    ProfileRegion regions[PROFILE_REGION_COUNT];
+
+    uint32_t leader; // slot of the block being executed
+    char new_block;
+
+    const char* path; // machine readable report
+} Profile;
+
+Profile* initialize_profile(const char* path);
+uint64_t profile_ticks();
+void run_profiled(Cpu* cpu);
+void profile_report(Profile* p);
+void profile_write(Profile* p);
+void profile_report_at_exit(Profile* p);
+
+#endif
@@ -2,38 +2,40 @@
 #define RAM_H
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define RAM_SIZE ((uint32_t)(2097152))
 #define RAM_GARBAGE 0xca
 
+// wide accesses are native loads and stores, guest memory is little endian
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "only little endian hosts are supported"
+#endif
+
 typedef struct {
-	uint32_t data[RAM_SIZE];
+	uint8_t* data; // swapped for a shared mapping by fastmem
 } Ram;
 
 Ram* initialize_ram() {
 	Ram* ram = malloc(sizeof(Ram));
+	ram->data = malloc(RAM_SIZE);
 
-	for (int i = 0; i < RAM_SIZE; ++i) {
-		ram->data[i] = RAM_GARBAGE;
-	}
+	memset(ram->data, RAM_GARBAGE, RAM_SIZE);
 
 	return ram;
 }
 
 uint32_t ram_load32(Ram* ram, uint32_t offset) {
-	uint32_t b0 = ram->data[offset + 0];
-	uint32_t b1 = ram->data[offset + 1];
-	uint32_t b2 = ram->data[offset + 2];
-	uint32_t b3 = ram->data[offset + 3];
-    
-	return b0 | ( b1 << 8 ) | ( b2 << 16 ) | ( b3 << 24 );
+	uint32_t v;
+	memcpy(&v, ram->data + offset, 4);
+	return v;
 }
 
 uint16_t ram_load16(Ram* ram, uint32_t offset) {
-	uint16_t b0 = ram->data[offset + 0];
-	uint16_t b1 = ram->data[offset + 1];
-
-	return b0 | (b1 << 8);
+	uint16_t v;
+	memcpy(&v, ram->data + offset, 2);
+	return v;
 }
 
 uint8_t ram_load8(Ram* ram, uint32_t offset) {
@@ -41,15 +43,11 @@ uint8_t ram_load8(Ram* ram, uint32_t offset) {
 }
 
 void ram_store32(Ram* ram, uint32_t offset, uint32_t value) {
-	ram->data[offset + 0] = (uint8_t)(value);
-	ram->data[offset + 1] = (uint8_t)(value >> 8);
-	ram->data[offset + 2] = (uint8_t)(value >> 16);
-	ram->data[offset + 3] = (uint8_t)(value >> 24);
+	memcpy(ram->data + offset, &value, 4);
 }
 
 void ram_store16(Ram* ram, uint32_t offset, uint16_t value) {    
-	ram->data[offset + 0] = (uint8_t)(value);	
-	ram->data[offset + 1] = (uint8_t)(value >> 8);
+	memcpy(ram->data + offset, &value, 2);
 }
 
 void ram_store8(Ram* ram, uint32_t offset, uint8_t value) {
@@ -0,0 +1,106 @@
+#include "scheduler.h"
+
+Scheduler* initialize_scheduler() {
+	Scheduler* s = malloc(sizeof(Scheduler));
+	s->count = 0;
+	s->deadline = NULL;
+	return s;
+}
+
+void scheduler_swap(Scheduler* s, uint32_t a, uint32_t b) {
+	Event e = s->heap[a];
+	s->heap[a] = s->heap[b];
+	s->heap[b] = e;
+}
+
+void scheduler_sift_up(Scheduler* s, uint32_t i) {
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+
+		if (s->heap[parent].time <= s->heap[i].time) {
+			break;
+		}
+
+		scheduler_swap(s, parent, i);
+		i = parent;
+	}
+}
+
+void scheduler_sift_down(Scheduler* s, uint32_t i) {
+	while (1) {
+		uint32_t min = i;
+		uint32_t l = i * 2 + 1;
+		uint32_t r = i * 2 + 2;
+
+		if (l < s->count && s->heap[l].time < s->heap[min].time) {
+			min = l;
+		}
+
+		if (r < s->count && s->heap[r].time < s->heap[min].time) {
+			min = r;
+		}
+
+		if (min == i) {
+			break;
+		}
+
+		scheduler_swap(s, min, i);
+		i = min;
+	}
+}
+
+void scheduler_remove_at(Scheduler* s, uint32_t i) {
+	s->count -= 1;
+
+	if (i == s->count) {
+		return;
+	}
+
+	s->heap[i] = s->heap[s->count];
+	scheduler_sift_down(s, i);
+	scheduler_sift_up(s, i);
+}
+
+void scheduler_add(Scheduler* s, uint64_t time, EventCallback callback, void* data) {
+	if (s->count == SCHEDULER_MAX_EVENTS) {
+		printf("too many scheduled events\n");
+		exit(1);
+	}
+
+	s->heap[s->count].time = time;
+	s->heap[s->count].callback = callback;
+	s->heap[s->count].data = data;
+	s->count += 1;
+
+	scheduler_sift_up(s, s->count - 1);
+
+	if (s->deadline != NULL && time < *s->deadline) {
+		*s->deadline = time;
+	}
+}
+
+void scheduler_cancel(Scheduler* s, EventCallback callback, void* data) {
+	for (uint32_t i = 0; i < s->count; ++i) {
+		if (s->heap[i].callback == callback && s->heap[i].data == data) {
+			return scheduler_remove_at(s, i);
+		}
+	}
+}
+
+uint64_t scheduler_next(Scheduler* s) {
+	if (s->count == 0) {
+		return UINT64_MAX;
+	}
+
+	return s->heap[0].time;
+}
+
+// fires everything due by now in time order, events are popped before their
+// callback runs so they can reschedule themselves
+void scheduler_run(Scheduler* s, uint64_t now) {
+	while (s->count > 0 && s->heap[0].time <= now) {
+		Event e = s->heap[0];
+		scheduler_remove_at(s, 0);
+		e.callback(s, e.data, e.time);
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_MAX_EVENTS 32
+
+typedef struct Scheduler Scheduler;
+
+// called once the cpu clock reaches time, may schedule again
+typedef void (*EventCallback)(Scheduler* s, void* data, uint64_t time);
+
+typedef struct {
+    uint64_t time;
+    EventCallback callback;
+    void* data;
+} Event;
+
+// min-heap of pending events ordered by time, in cpu cycles
+typedef struct Scheduler {
+    Event heap[SCHEDULER_MAX_EVENTS];
+    uint32_t count;
+
+    // deadline of the cpu run in progress, lowered when an earlier event is added
+    uint64_t* deadline;
+} Scheduler;
+
+Scheduler* initialize_scheduler();
+void scheduler_add(Scheduler* s, uint64_t time, EventCallback callback, void* data);
+void scheduler_cancel(Scheduler* s, EventCallback callback, void* data);
+uint64_t scheduler_next(Scheduler* s);
+void scheduler_run(Scheduler* s, uint64_t now);
+
+#endif
@@ -0,0 +1,94 @@
+#include "timing.h"
+
+#include "interconnect.h"
+
+// RAM loads wait for the bus, stores go through the write buffer. The BIOS
+// ROM sits on an 8 bit bus, so every byte of a word is a separate access.
+const uint8_t LOAD_CYCLES[3][REGION_COUNT] = {
+	{ 4, 6, 0, 3 },
+	{ 4, 12, 0, 3 },
+	{ 4, 24, 0, 3 },
+};
+
+const uint8_t STORE_CYCLES[3][REGION_COUNT] = {
+	{ 0, 0, 0, 2 },
+	{ 0, 0, 0, 2 },
+	{ 0, 0, 0, 2 },
+};
+
+// command cycles, including the time before the results can be read back
+const uint8_t GTE_CYCLES[64] = {
+	[0x01] = 15, // RTPS
+	[0x06] = 8, // NCLIP
+	[0x0c] = 6, // OP
+	[0x10] = 8, // DPCS
+	[0x11] = 8, // INTPL
+	[0x12] = 8, // MVMVA
+	[0x13] = 19, // NCDS
+	[0x14] = 13, // CDP
+	[0x16] = 44, // NCDT
+	[0x1b] = 17, // NCCS
+	[0x1c] = 11, // CC
+	[0x1e] = 14, // NCS
+	[0x20] = 30, // NCT
+	[0x28] = 5, // SQR
+	[0x29] = 8, // DCPL
+	[0x2a] = 17, // DPCT
+	[0x2d] = 5, // AVSZ3
+	[0x2e] = 6, // AVSZ4
+	[0x30] = 23, // RTPT
+	[0x3d] = 5, // GPF
+	[0x3e] = 5, // GPL
+	[0x3f] = 39, // NCCT
+};
+
+uint8_t* initialize_timing_regions() {
+	uint8_t* regions = malloc(TIMING_PAGE_COUNT);
+
+	for (uint32_t i = 0; i < TIMING_PAGE_COUNT; ++i) {
+		uint32_t phys = mask_region(i << TIMING_PAGE_SHIFT);
+
+		if (phys < RAM_SIZE * 4) {
+			regions[i] = REGION_RAM;
+		} else if (phys - BIOS_RANGE[0] < BIOS_SIZE) {
+			regions[i] = REGION_BIOS;
+		} else if (phys >> TIMING_PAGE_SHIFT == SCRATCHPAD[0] >> TIMING_PAGE_SHIFT) {
+			regions[i] = REGION_SCRATCHPAD;
+		} else {
+			regions[i] = REGION_IO;
+		}
+	}
+
+	return regions;
+}
+
+// KSEG1 bypasses the instruction cache and always pays for the bus, anything
+// else costs a cycle on a hit and icache_fetch adds the refills
+uint32_t timing_fetch_cycles(uint8_t* regions, uint32_t pc) {
+	if (pc >> 29 != 5) {
+		return 1;
+	}
+
+	return 1 + LOAD_CYCLES[2][regions[pc >> TIMING_PAGE_SHIFT]];
+}
+
+uint32_t timing_gte_cycles(uint32_t cmd) {
+	return GTE_CYCLES[cmd & 0x3f];
+}
+
+// the multiplier stops early once the remaining bits of rs are all sign bits
+uint32_t timing_mult_cycles(uint32_t rs, char is_signed) {
+	if (is_signed == 1 && (int32_t)rs < 0) {
+		rs = ~rs;
+	}
+
+	if (rs < 0x800) {
+		return MULT_CYCLES_SMALL;
+	}
+
+	if (rs < 0x100000) {
+		return MULT_CYCLES_MEDIUM;
+	}
+
+	return MULT_CYCLES_LARGE;
+}
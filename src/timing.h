@@ -0,0 +1,34 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+// access costs are looked up per 4 kB page of the virtual address space,
+// small enough to keep the scratchpad apart from the io ports
+#define TIMING_PAGE_SHIFT 12
+#define TIMING_PAGE_COUNT (1 << (32 - TIMING_PAGE_SHIFT))
+
+// cycles until hi/lo are ready, multiplies finish early for small rs
+#define MULT_CYCLES_SMALL 6
+#define MULT_CYCLES_MEDIUM 9
+#define MULT_CYCLES_LARGE 13
+#define DIV_CYCLES 36
+
+typedef enum {
+    REGION_RAM,
+    REGION_BIOS,
+    REGION_SCRATCHPAD,
+    REGION_IO,
+    REGION_COUNT,
+} MemRegion;
+
+// extra cycles of a data access, by log2 of the width and region
+extern const uint8_t LOAD_CYCLES[3][REGION_COUNT];
+extern const uint8_t STORE_CYCLES[3][REGION_COUNT];
+
+uint8_t* initialize_timing_regions();
+uint32_t timing_fetch_cycles(uint8_t* regions, uint32_t pc);
+uint32_t timing_gte_cycles(uint32_t cmd);
+uint32_t timing_mult_cycles(uint32_t rs, char is_signed);
+
+#endif
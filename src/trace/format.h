@@ -0,0 +1,234 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Execution trace format, shared by the recorder and tracecmp.
+//
+// After the magic every executed instruction is one record:
+//   header byte: TRACE_SEQUENTIAL, TRACE_CACHED, number of register writes
+//   pc - (last pc + 4) as a zigzag varint unless TRACE_SEQUENTIAL
+//   the instruction word, 4 bytes, unless TRACE_CACHED
+//   per write: register index, new - old value as a zigzag varint
+// Registers are the gprs followed by hi and lo. Instruction words are cached
+// by pc in a direct mapped table both sides keep in sync.
+
+#define TRACE_MAGIC "PSXTRC01"
+#define TRACE_REGS 34
+#define TRACE_INSTR_CACHE 4096
+
+#define TRACE_SEQUENTIAL 0x1
+#define TRACE_CACHED 0x2
+#define TRACE_WRITES_SHIFT 2
+
+// header, pc, instruction and every register written
+#define TRACE_MAX_RECORD (1 + 5 + 4 + TRACE_REGS * 6)
+
+typedef struct {
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t regs[TRACE_REGS];
+
+    uint32_t cache_pc[TRACE_INSTR_CACHE];
+    uint32_t cache_instr[TRACE_INSTR_CACHE];
+
+    // registers written by the last record
+    uint8_t written[TRACE_REGS];
+    uint32_t written_count;
+} TraceState;
+
+void trace_state_init(TraceState* s) {
+    memset(s, 0, sizeof(TraceState));
+    s->pc = 0xfffffffc;
+
+    for (int i = 0; i < TRACE_INSTR_CACHE; ++i) {
+        s->cache_pc[i] = 0xffffffff;
+    }
+}
+
+uint32_t trace_cache_slot(uint32_t pc) {
+    return (pc >> 2) & (TRACE_INSTR_CACHE - 1);
+}
+
+uint32_t trace_put_varint(uint8_t* out, uint32_t v) {
+    uint32_t len = 0;
+
+    while (v >= 0x80) {
+        out[len++] = v | 0x80;
+        v >>= 7;
+    }
+    out[len++] = v;
+
+    return len;
+}
+
+uint32_t trace_zigzag(uint32_t v) {
+    return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+uint32_t trace_unzigzag(uint32_t v) {
+    return (v >> 1) ^ -(v & 1);
+}
+
+// appends the record for one instruction to out, returns its length
+uint32_t trace_encode(TraceState* s, uint8_t* out, uint32_t pc, uint32_t instr, uint32_t* regs) {
+    uint32_t len = 1;
+    uint8_t header = 0;
+
+    if (pc == s->pc + 4) {
+        header |= TRACE_SEQUENTIAL;
+    } else {
+        len += trace_put_varint(out + len, trace_zigzag(pc - (s->pc + 4)));
+    }
+
+    uint32_t slot = trace_cache_slot(pc);
+
+    if (s->cache_pc[slot] == pc && s->cache_instr[slot] == instr) {
+        header |= TRACE_CACHED;
+    } else {
+        s->cache_pc[slot] = pc;
+        s->cache_instr[slot] = instr;
+        memcpy(out + len, &instr, 4);
+        len += 4;
+    }
+
+    uint32_t writes = 0;
+
+    for (int i = 0; i < TRACE_REGS; ++i) {
+        if (regs[i] != s->regs[i]) {
+            out[len++] = i;
+            len += trace_put_varint(out + len, trace_zigzag(regs[i] - s->regs[i]));
+            s->regs[i] = regs[i];
+            writes += 1;
+        }
+    }
+
+    out[0] = header | writes << TRACE_WRITES_SHIFT;
+    s->pc = pc;
+    s->instr = instr;
+
+    return len;
+}
+
+typedef struct {
+    FILE* file;
+    uint8_t buffer[1 << 20];
+    uint32_t pos;
+    uint32_t len;
+
+    TraceState state;
+    uint64_t index; // records decoded so far
+} TraceReader;
+
+// NULL if the file can't be opened or isn't a trace
+TraceReader* trace_open(const char* path) {
+    FILE* file = fopen(path, "rb");
+    char magic[8];
+
+    if (file == NULL) {
+        return NULL;
+    }
+
+    if (fread(magic, 8, 1, file) != 1 || memcmp(magic, TRACE_MAGIC, 8) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    TraceReader* r = malloc(sizeof(TraceReader));
+    r->file = file;
+    r->pos = 0;
+    r->len = 0;
+    r->index = 0;
+    trace_state_init(&r->state);
+
+    return r;
+}
+
+void trace_close(TraceReader* r) {
+    fclose(r->file);
+    free(r);
+}
+
+// -1 at the end of the file
+int trace_get_byte(TraceReader* r) {
+    if (r->pos == r->len) {
+        r->len = fread(r->buffer, 1, sizeof(r->buffer), r->file);
+        r->pos = 0;
+
+        if (r->len == 0) {
+            return -1;
+        }
+    }
+
+    return r->buffer[r->pos++];
+}
+
+uint32_t trace_get_varint(TraceReader* r) {
+    uint32_t v = 0;
+
+    for (int shift = 0; shift < 35; shift += 7) {
+        int b = trace_get_byte(r);
+
+        if (b < 0) {
+            break;
+        }
+
+        v |= (uint32_t)(b & 0x7f) << shift;
+
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+
+    return v;
+}
+
+// decodes the next record into r->state, returns 0 at the end of the trace
+char trace_next(TraceReader* r) {
+    TraceState* s = &r->state;
+    int header = trace_get_byte(r);
+
+    if (header < 0) {
+        return 0;
+    }
+
+    if ((header & TRACE_SEQUENTIAL) != 0) {
+        s->pc += 4;
+    } else {
+        s->pc += 4 + trace_unzigzag(trace_get_varint(r));
+    }
+
+    uint32_t slot = trace_cache_slot(s->pc);
+
+    if ((header & TRACE_CACHED) != 0) {
+        s->instr = s->cache_instr[slot];
+    } else {
+        uint32_t instr = 0;
+
+        for (int i = 0; i < 4; ++i) {
+            instr |= (uint32_t)(trace_get_byte(r) & 0xff) << (i * 8);
+        }
+
+        s->instr = instr;
+        s->cache_pc[slot] = s->pc;
+        s->cache_instr[slot] = instr;
+    }
+
+    s->written_count = header >> TRACE_WRITES_SHIFT;
+
+    for (uint32_t i = 0; i < s->written_count; ++i) {
+        uint8_t reg = trace_get_byte(r) % TRACE_REGS;
+
+        s->regs[reg] += trace_unzigzag(trace_get_varint(r));
+        s->written[i] = reg;
+    }
+
+    r->index += 1;
+
+    return 1;
+}
+
+#endif
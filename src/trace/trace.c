@@ -0,0 +1,140 @@
+#include "trace.h"
+
+#include "../cpu.h"
+
+// writes queued chunks until the recorder is finished
+void* trace_writer(void* arg) {
+	Trace* t = arg;
+
+	pthread_mutex_lock(&t->lock);
+
+	while (1) {
+		while (t->tail == t->head && t->done == 0) {
+			pthread_cond_wait(&t->cond, &t->lock);
+		}
+
+		if (t->tail == t->head) {
+			break;
+		}
+
+		uint32_t slot = t->tail % TRACE_RING_CHUNKS;
+		pthread_mutex_unlock(&t->lock);
+
+		fwrite(t->chunks[slot], 1, t->lens[slot], t->file);
+
+		pthread_mutex_lock(&t->lock);
+		t->tail += 1;
+		pthread_cond_broadcast(&t->cond);
+	}
+
+	pthread_mutex_unlock(&t->lock);
+
+	return NULL;
+}
+
+Trace* initialize_trace(const char* path) {
+	Trace* t = malloc(sizeof(Trace));
+
+	t->file = fopen(path, "wb");
+
+	if (t->file == NULL) {
+		printf("can't write trace: %s\n", path);
+		exit(1);
+	}
+
+	fwrite(TRACE_MAGIC, 1, 8, t->file);
+	trace_state_init(&t->state);
+
+	for (int i = 0; i < TRACE_RING_CHUNKS; ++i) {
+		t->chunks[i] = malloc(TRACE_CHUNK_SIZE);
+		t->lens[i] = 0;
+	}
+
+	t->head = 0;
+	t->tail = 0;
+	t->chunk = t->chunks[0];
+	t->len = 0;
+	t->done = 0;
+	t->records = 0;
+	t->bytes = 8;
+
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->cond, NULL);
+	pthread_create(&t->thread, NULL, trace_writer, t);
+
+	return t;
+}
+
+// hands the current chunk to the writer, waits while the ring is full
+void trace_submit(Trace* t) {
+	pthread_mutex_lock(&t->lock);
+
+	t->lens[t->head % TRACE_RING_CHUNKS] = t->len;
+	t->head += 1;
+	pthread_cond_broadcast(&t->cond);
+
+	while (t->head - t->tail >= TRACE_RING_CHUNKS) {
+		pthread_cond_wait(&t->cond, &t->lock);
+	}
+
+	pthread_mutex_unlock(&t->lock);
+
+	t->bytes += t->len;
+	t->chunk = t->chunks[t->head % TRACE_RING_CHUNKS];
+	t->len = 0;
+}
+
+// run_next_instruction followed by a trace record, cpu_run_for calls this
+// instead of the dispatchers while recording
+void run_traced(Cpu* cpu) {
+	Trace* t = cpu->trace;
+	uint32_t regs[TRACE_REGS];
+
+	while (cpu->cycles < cpu->deadline) {
+		uint32_t pc = cpu->pc;
+		uint32_t instr = cpu_peek32(cpu, pc);
+
+		run_next_instruction(cpu);
+
+		memcpy(regs, cpu->regs, sizeof(cpu->regs));
+		regs[32] = cpu->hi;
+		regs[33] = cpu->lo;
+
+		t->len += trace_encode(&t->state, t->chunk + t->len, pc, instr, regs);
+		t->records += 1;
+
+		if (t->len > TRACE_CHUNK_SIZE - TRACE_MAX_RECORD) {
+			trace_submit(t);
+		}
+	}
+}
+
+// flushes everything and stops the writer
+void trace_finish(Trace* t) {
+	if (t->len > 0) {
+		trace_submit(t);
+	}
+
+	pthread_mutex_lock(&t->lock);
+	t->done = 1;
+	pthread_cond_broadcast(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+
+	pthread_join(t->thread, NULL);
+	fclose(t->file);
+
+	printf("trace: %llu instructions in %llu bytes, %.2f bytes/instruction\n",
+	       (unsigned long long)t->records, (unsigned long long)t->bytes,
+	       t->records > 0 ? (double)t->bytes / t->records : 0.0);
+}
+
+Trace* trace_exit_finish = NULL;
+
+void trace_exit() {
+	trace_finish(trace_exit_finish);
+}
+
+void trace_finish_at_exit(Trace* t) {
+	trace_exit_finish = t;
+	atexit(trace_exit);
+}
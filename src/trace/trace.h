@@ -0,0 +1,42 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "format.h"
+
+#define TRACE_CHUNK_SIZE (1 << 20)
+// chunks waiting for the writer thread before the cpu has to wait for it
+#define TRACE_RING_CHUNKS 16
+
+typedef struct Cpu Cpu;
+
+typedef struct Trace {
+    FILE* file;
+    TraceState state;
+
+    // chunks tail..head-1 are full and queued, the cpu fills chunk head
+    uint8_t* chunks[TRACE_RING_CHUNKS];
+    uint32_t lens[TRACE_RING_CHUNKS];
+    uint32_t head;
+    uint32_t tail;
+    uint8_t* chunk;
+    uint32_t len;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char done;
+
+    uint64_t records;
+    uint64_t bytes;
+} Trace;
+
+Trace* initialize_trace(const char* path);
+void run_traced(Cpu* cpu);
+void trace_finish(Trace* t);
+void trace_finish_at_exit(Trace* t);
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "format.h"
+
+// usage: tracecmp <trace>           prints every record
+//        tracecmp <trace> <trace>   finds the first record the two differ at
+
+const char* TRACE_REG_NAMES[TRACE_REGS] = {
+	"zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+	"t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+	"s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+	"t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+	"hi", "lo",
+};
+
+void print_record(TraceReader* r) {
+	TraceState* s = &r->state;
+
+	printf("%llu: %08x %08x", (unsigned long long)r->index - 1, s->pc, s->instr);
+
+	for (uint32_t i = 0; i < s->written_count; ++i) {
+		printf(" %s=%08x", TRACE_REG_NAMES[s->written[i]], s->regs[s->written[i]]);
+	}
+
+	printf("\n");
+}
+
+int dump(TraceReader* r) {
+	while (trace_next(r) == 1) {
+		print_record(r);
+	}
+
+	return 0;
+}
+
+int compare(TraceReader* a, TraceReader* b) {
+	uint32_t last_pc = 0;
+
+	while (1) {
+		char more_a = trace_next(a);
+		char more_b = trace_next(b);
+
+		if (more_a == 0 || more_b == 0) {
+			if (more_a == more_b) {
+				printf("traces match: %llu instructions\n", (unsigned long long)a->index);
+				return 0;
+			}
+
+			printf("%s trace ends first after %llu instructions, last pc %08x\n",
+			       more_a == 0 ? "first" : "second",
+			       (unsigned long long)(more_a == 0 ? a->index : b->index), last_pc);
+			return 1;
+		}
+
+		TraceState* sa = &a->state;
+		TraceState* sb = &b->state;
+
+		if (sa->pc != sb->pc || sa->instr != sb->instr
+		    || memcmp(sa->regs, sb->regs, sizeof(sa->regs)) != 0) {
+			printf("traces differ at instruction %llu, previous pc %08x\n",
+			       (unsigned long long)a->index - 1, last_pc);
+			print_record(a);
+			print_record(b);
+
+			for (int i = 0; i < TRACE_REGS; ++i) {
+				if (sa->regs[i] != sb->regs[i]) {
+					printf("  %-4s %08x %08x\n", TRACE_REG_NAMES[i], sa->regs[i], sb->regs[i]);
+				}
+			}
+
+			return 1;
+		}
+
+		last_pc = sa->pc;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 2 && argc != 3) {
+		printf("usage: %s <trace> [other trace]\n", argv[0]);
+		return 2;
+	}
+
+	TraceReader* readers[2];
+
+	for (int i = 1; i < argc; ++i) {
+		readers[i - 1] = trace_open(argv[i]);
+
+		if (readers[i - 1] == NULL) {
+			printf("can't read trace: %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	if (argc == 2) {
+		return dump(readers[0]);
+	}
+
+	return compare(readers[0], readers[1]);
+}